@@ -1,190 +1,324 @@
 #pragma once
 #include <iostream>
 #include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+// Sizes and indices of Vector and matrix. 64 bits, so a single
+// container can hold more than 2^31 elements; signed, so differences
+// of indices and checks like index < 0 stay meaningful.
+using index_t = std::ptrdiff_t;
+
+// Tag for operations that leave new elements unwritten
+struct uninitialized_t { explicit uninitialized_t () = default; };
+inline constexpr uninitialized_t uninitialized {};
 
 template <typename T>
 class linearList {
     public:
         virtual bool empty() const = 0;
-        virtual int size() const = 0;
-        virtual T& at(int atindx) const = 0;
-        virtual void erase(int atindx) = 0;
-        virtual void insert(int atindx, const T& elem) = 0;
+        virtual index_t size() const = 0;
+        virtual T& at(index_t atindx) const = 0;
+        virtual void erase(index_t atindx) = 0;
+        virtual void insert(index_t atindx, const T& elem) = 0;
         virtual void output(std::ostream& out) const = 0;
         virtual ~linearList() {};
 };
 
-template <typename T>
+// With N > 0 the first N elements of capacity live inside the Vector
+// itself, so short lists never touch the heap.
+template <typename T, int N = 0>
 class Vector : public linearList<T> {
 #define VEC_INIT_CAPACITY           10
 #define VEC_CAPACITY_ADD_FACTOR     2
-    
+#define VEC_SHRINK_DIVISOR          4
+
   public:
-    Vector (int init_capacity = VEC_INIT_CAPACITY, double capacity_add_factor = VEC_CAPACITY_ADD_FACTOR);
+    Vector (index_t init_capacity = N > 0 ? N : VEC_INIT_CAPACITY, double capacity_add_factor = VEC_CAPACITY_ADD_FACTOR);
     Vector (std::initializer_list<T> init_lst);
 
     // Copy constructor
-    Vector (const Vector<T>&);
+    Vector (const Vector&);
 
     // Copy assignment
-    Vector<T>& operator =(const Vector<T>&);
+    Vector& operator =(const Vector&);
 
     // Move constructor
-    Vector (Vector<T>&&);
+    Vector (Vector&&);
 
 
     // Move assignment
-    Vector<T>& operator = (Vector<T>&&);
+    Vector& operator = (Vector&&);
 
     ~Vector ();
 
     bool empty () const {return lstsize == 0;};
-    int size () const {return lstsize;};
-    int capacity() const {return arsize;};
-    T& at (int atindx) const;
-    void insert (int atindx, const T& elem);
+    index_t size () const {return lstsize;};
+    index_t capacity() const {return arsize;};
+    T& at (index_t atindx) const;
+    void insert (index_t atindx, const T& elem);
     void push_back(const T& elem);
     void pop_back();
-    void erase (int atindx);
+    void erase (index_t atindx);
     void output (std::ostream& out) const;
     T* begin() {return elems;};
     T* end() {return elems+lstsize;};
+    const T* begin() const {return elems;};
+    const T* end() const {return elems+lstsize;};
+    // raw access to the underlying contiguous storage
+    T* data() {return elems;};
+    const T* data() const {return elems;};
     // == operator needs to be added
 
-    void    resize(int sz);
+    // Range versions: one reallocation and one shift of the tail at most,
+    // however long the range. [first, last) must not point into this list.
+    template <std::forward_iterator It>
+    void insert (index_t atindx, It first, It last);
+    template <std::forward_iterator It>
+    void append (It first, It last) {insert(lstsize, first, last);};
+    template <std::forward_iterator It>
+    void assign (It first, It last);
+    // Erase the elements at [first, last)
+    void erase (index_t first, index_t last);
+
+    void    resize(index_t sz);
+    // resize without writing the new elements: their values are
+    // indeterminate, and freshly allocated pages stay untouched
+    void    resize(index_t sz, uninitialized_t);
+    // As resize, but when the capacity has to grow it becomes exactly sz.
+    // For storage that is sized once and not grown element by element
+    // afterwards, where geometric growth would leave up to as much again
+    // allocated and unused.
+    void    resize_exact(index_t sz) {reserve(sz); resize(sz);};
+    void    resize_exact(index_t sz, uninitialized_t) {reserve(sz); resize(sz, uninitialized);};
+    // Grow the capacity to at least cap without changing the size
+    void reserve(index_t cap);
+    // Drop the unused capacity
+    void shrink_to_fit();
     // Make the list empty
     void clear ();
 
-    T& operator[] (int index);
-    const T& operator[] (int index) const;
+    // Erasing halves the capacity (but not below the initial one) once
+    // fewer than capacity/divisor elements are left. 0 never shrinks;
+    // otherwise divisor must be at least 3 so that a push right after a
+    // shrink does not grow the array straight back.
+    void set_shrink_threshold (int divisor);
+    int shrink_threshold () const {return shrink_divisor;};
+
+    T& operator[] (index_t index);
+    const T& operator[] (index_t index) const;
 
   private:
     void checkListSizeThreshold ();
-    void checkindex(int index) const;
+    void checkindex(index_t index) const;
+    index_t grown_capacity (index_t needed) const;
+    void change_len (index_t nlen);
+    T* allocate (index_t len);
+    void release (T* p);
+    void take (Vector& lst);
     T* elems;
-    int arsize;
-    int init_arsize;
-    int lstsize;
+    index_t arsize;
+    index_t init_arsize;
+    index_t lstsize;
     double arl_capacity_add_factor;
+    int shrink_divisor = VEC_SHRINK_DIVISOR;
+    [[no_unique_address]] std::array<T, N> inline_elems;
 };
 
-template <typename T>
-static void change_len_1d (T*& elems, int& len, int nlen) {
-    if (len == nlen)
+// Storage for len elements, the inline buffer if it is large enough
+template <typename T, int N>
+T* Vector<T, N>::allocate (index_t len) {
+    if constexpr (N > 0) {
+        if (len <= N)
+            return inline_elems.data();
+    }
+    return new T[len];
+}
+
+template <typename T, int N>
+void Vector<T, N>::release (T* p) {
+    if constexpr (N > 0) {
+        if (p == inline_elems.data())
+            return;
+    }
+    delete [] p;
+}
+
+template <typename T, int N>
+void Vector<T, N>::change_len (index_t nlen) {
+    if (arsize == nlen)
         return;
 
-    T* nelems;
-    nelems = new T[nlen];
-    std::copy(elems, elems+std::min(len, nlen), nelems);
-    delete [] elems;
-    elems = nelems;
-    len = nlen;
+    T* nelems = allocate(nlen);
+    if (nelems != elems) {
+        std::copy(elems, elems+std::min(lstsize, nlen), nelems);
+        release(elems);
+        elems = nelems;
+    }
+    arsize = nlen;
+}
+
+// Capacity after growing geometrically until needed elements fit.
+// Always grows by at least one, whatever the add factor.
+template <typename T, int N>
+index_t Vector<T, N>::grown_capacity (index_t needed) const {
+    index_t nlen = std::max(arsize, index_t {1});
+    while (needed > nlen) {
+        nlen = std::max(nlen + 1, static_cast<index_t>(nlen * arl_capacity_add_factor));
+    }
+    return nlen;
 }
 
-template <typename T>
-void Vector<T>::checkListSizeThreshold () {
-    if (lstsize < arsize/4) {
-        int nlen = std::max(arsize/2, init_arsize);
-        change_len_1d(elems, arsize, nlen);
+template <typename T, int N>
+void Vector<T, N>::checkListSizeThreshold () {
+    if (shrink_divisor == 0)
+        return;
+    if (lstsize < arsize/shrink_divisor) {
+        index_t nlen = std::max(arsize/2, init_arsize);
+        change_len(nlen);
     }
 }
 
-template<typename T>
-Vector<T>::Vector (int init_capacity, double capacity_add_factor) {
+template <typename T, int N>
+void Vector<T, N>::set_shrink_threshold (int divisor) {
+    if (divisor != 0 && divisor < 3) {
+        throw std::invalid_argument {"Invalid shrink threshold"};
+    }
+    shrink_divisor = divisor;
+}
+
+template<typename T, int N>
+Vector<T, N>::Vector (index_t init_capacity, double capacity_add_factor) {
     if (init_capacity < 1) {
         throw std::length_error {"Invalid array length"};
     }
 
-    elems = new T[init_capacity];
+    elems = allocate(init_capacity);
     init_arsize = arsize = init_capacity;
     arl_capacity_add_factor = capacity_add_factor;
     lstsize = 0;
 }
 
-template <typename T>
-Vector<T>::Vector (std::initializer_list<T> init_lst): Vector(static_cast<int>(init_lst.size()) * 2) {
+template <typename T, int N>
+Vector<T, N>::Vector (std::initializer_list<T> init_lst): Vector(std::max(static_cast<index_t>(init_lst.size()) * 2, index_t {1})) {
     std::copy(init_lst.begin(), init_lst.end(), elems);
-    lstsize = static_cast<int>(init_lst.size());
+    lstsize = static_cast<index_t>(init_lst.size());
 }
 
 // Copy constructor
-template <typename T>
-Vector<T>::Vector (const Vector<T>& lst) {
-    elems = new T[lst.arsize];
+template <typename T, int N>
+Vector<T, N>::Vector (const Vector& lst) {
+    elems = allocate(lst.arsize);
     arsize = lst.arsize;
+    init_arsize = lst.init_arsize;
+    arl_capacity_add_factor = lst.arl_capacity_add_factor;
+    shrink_divisor = lst.shrink_divisor;
     lstsize = lst.lstsize;
     std::copy(lst.elems, lst.elems+lst.lstsize, elems);
 }
 
 // Copy assignment
-template <typename T>
-Vector<T>& Vector<T>::operator = (const Vector<T>& lst) {
-    auto p = new T[lst.arsize];
+template <typename T, int N>
+Vector<T, N>& Vector<T, N>::operator = (const Vector& lst) {
+    if (this == &lst)
+        return *this;
+
+    auto p = allocate(lst.arsize);
     std::copy(lst.elems, lst.elems+lst.lstsize, p);
-    delete [] elems; // Delete old elements
+    if (p != elems)
+        release(elems); // Delete old elements
     elems = p;
     arsize = lst.arsize;
+    init_arsize = lst.init_arsize;
+    arl_capacity_add_factor = lst.arl_capacity_add_factor;
+    shrink_divisor = lst.shrink_divisor;
     lstsize = lst.lstsize;
     return *this;
 }
 
-// Move constructor
-template <typename T>
-Vector<T>::Vector (Vector<T>&& lst) {
-    elems = lst.elems;
-    arsize = lst.arsize;
+// Take over the elements of lst and leave it empty. Heap storage just
+// changes hands; inline elements have to be copied.
+template <typename T, int N>
+void Vector<T, N>::take (Vector& lst) {
+    init_arsize = lst.init_arsize;
+    arl_capacity_add_factor = lst.arl_capacity_add_factor;
+    shrink_divisor = lst.shrink_divisor;
     lstsize = lst.lstsize;
-    
-    // Clear the rvalue
-    lst.elems = nullptr;
-    lst.arsize = 0;
-    lst.lstsize = 0;
-}
 
-// Move assignment
-template <typename T>
-Vector<T>& Vector<T>::operator =(Vector<T>&& lst) {
-    delete [] elems;
+    if constexpr (N > 0) {
+        if (lst.elems == lst.inline_elems.data()) {
+            elems = inline_elems.data();
+            arsize = lst.arsize;
+            std::copy(lst.elems, lst.elems+lst.lstsize, elems);
+            lst.lstsize = 0;
+            return;
+        }
+    }
 
     elems = lst.elems;
     arsize = lst.arsize;
-    lstsize = lst.lstsize;
 
     // Clear the rvalue
-    lst.elems = nullptr;
-    lst.arsize = 0;
+    if constexpr (N > 0) {
+        lst.elems = lst.inline_elems.data();
+        lst.arsize = N;
+    } else {
+        lst.elems = nullptr;
+        lst.arsize = 0;
+    }
     lst.lstsize = 0;
+}
+
+// Move constructor
+template <typename T, int N>
+Vector<T, N>::Vector (Vector&& lst) {
+    take(lst);
+}
+
+// Move assignment
+template <typename T, int N>
+Vector<T, N>& Vector<T, N>::operator =(Vector&& lst) {
+    if (this == &lst)
+        return *this;
+
+    release(elems);
+    take(lst);
     return *this;
 }
- 
-template <typename T>
-Vector<T>::~Vector () {
-    delete [] elems;
+
+template <typename T, int N>
+Vector<T, N>::~Vector () {
+    release(elems);
 }
 
-template <typename T>
-T& Vector<T>::at (int atindx) const {
+template <typename T, int N>
+T& Vector<T, N>::at (index_t atindx) const {
     checkindex(atindx);
     return elems[atindx];
 }
 
-template <typename T>
-void Vector<T>::insert (int atindx, const T& elem) {
+template <typename T, int N>
+void Vector<T, N>::insert (index_t atindx, const T& elem) {
+    if (atindx != lstsize) {
+        checkindex(atindx);
+    }
     if (arsize == lstsize) {
-        change_len_1d(elems, arsize, arsize * arl_capacity_add_factor);
+        change_len(grown_capacity(lstsize + 1));
     }
     if (atindx != lstsize) {
-        checkindex(atindx);
         std::copy_backward(elems+atindx, elems+lstsize, elems+lstsize+1);
     }
     elems[atindx] = elem;
     ++lstsize;
 }
 
-template <typename T>
-void Vector<T>::push_back(const T& elem) {
+template <typename T, int N>
+void Vector<T, N>::push_back(const T& elem) {
     if (arsize == lstsize) {
-        change_len_1d(elems, arsize, arsize * arl_capacity_add_factor);
+        change_len(grown_capacity(lstsize + 1));
     }
     elems[lstsize] = elem;
     ++lstsize;
@@ -193,50 +327,125 @@ void Vector<T>::push_back(const T& elem) {
 // Just erase the element at the right end of the list
 // Do not return any value. If you need it, use/implement
 // a separate method, say top, to get that element before pop.
-template <typename T>
-void Vector<T>::pop_back() {
+template <typename T, int N>
+void Vector<T, N>::pop_back() {
     if (lstsize == 0)
         return;
-    elems[lstsize-1] = T {};
+    // Only elements holding resources need the popped slot reset
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+        elems[lstsize-1] = T {};
+    }
     --lstsize;
     checkListSizeThreshold();
 }
 
-template <typename T>
-void Vector<T>::erase (int atindx) {
+template <typename T, int N>
+void Vector<T, N>::erase (index_t atindx) {
     checkindex(atindx);
     std::copy(elems+atindx+1, elems+lstsize, elems+atindx);
     --lstsize;
     checkListSizeThreshold();
 }
 
-template <typename T>
-void Vector<T>::output (std::ostream& out) const {
-    for (int i = 0; i < lstsize; i++) {
+template <typename T, int N>
+template <std::forward_iterator It>
+void Vector<T, N>::insert (index_t atindx, It first, It last) {
+    if (atindx != lstsize) {
+        checkindex(atindx);
+    }
+    const index_t n = static_cast<index_t>(std::distance(first, last));
+    if (n == 0)
+        return;
+
+    if (lstsize + n > arsize) {
+        index_t nlen = grown_capacity(lstsize + n);
+        T* nelems = allocate(nlen);
+        if (nelems != elems) {
+            // Lay the elements out in their final places straight away
+            std::copy(elems, elems+atindx, nelems);
+            std::copy(first, last, nelems+atindx);
+            std::copy(elems+atindx, elems+lstsize, nelems+atindx+n);
+            release(elems);
+            elems = nelems;
+            arsize = nlen;
+            lstsize += n;
+            return;
+        }
+        arsize = nlen;
+    }
+    std::copy_backward(elems+atindx, elems+lstsize, elems+lstsize+n);
+    std::copy(first, last, elems+atindx);
+    lstsize += n;
+}
+
+template <typename T, int N>
+template <std::forward_iterator It>
+void Vector<T, N>::assign (It first, It last) {
+    const index_t n = static_cast<index_t>(std::distance(first, last));
+    if (n > arsize) {
+        // The old elements are dropped, so nothing needs copying over
+        index_t nlen = grown_capacity(n);
+        T* nelems = allocate(nlen);
+        if (nelems != elems) {
+            release(elems);
+            elems = nelems;
+        }
+        arsize = nlen;
+    }
+    std::copy(first, last, elems);
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+        for (index_t i = n; i < lstsize; i++) {
+            elems[i] = T {};
+        }
+    }
+    lstsize = n;
+}
+
+template <typename T, int N>
+void Vector<T, N>::erase (index_t first, index_t last) {
+    if (first < 0 || last > lstsize || first > last)
+        throw std::length_error("Invalid index");
+    if (first == last)
+        return;
+
+    std::copy(elems+last, elems+lstsize, elems+first);
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+        for (index_t i = lstsize - (last-first); i < lstsize; i++) {
+            elems[i] = T {};
+        }
+    }
+    lstsize -= last - first;
+    checkListSizeThreshold();
+}
+
+template <typename T, int N>
+void Vector<T, N>::output (std::ostream& out) const {
+    for (index_t i = 0; i < lstsize; i++) {
         out << elems[i] << " ; ";
     }
     out << std::endl;
 }
 
-template <typename T>
-void Vector<T>::resize(int sz)
+template <typename T, int N>
+void Vector<T, N>::resize(index_t sz)
 {
     // If the original list size (lstsize) is less than the new one,
-    // NULL elements (ie., default elements) are automatically added.
-    // Nothing specific to do in this case
+    // NULL elements (ie., default elements) are added.
     if (sz > arsize) {
-        int nlen = arsize;
-        while (sz > nlen) {
-            nlen *= arl_capacity_add_factor;
-        }
-        change_len_1d(elems, arsize, nlen);
+        change_len(grown_capacity(sz));
+    }
+
+    // Slots beyond lstsize may hold stale or (for built-in types)
+    // uninitialized values, so explicitly default them.
+    if (sz > lstsize) {
+        std::fill(elems+lstsize, elems+sz, T {});
     }
 
     // If the original size is more than the new one, extra elements
     // are removed. Just setting the elements to default constructor
     // will do the deed.
     if (sz < lstsize) {
-        for (int i = sz; i < lstsize; i++) {
+        for (index_t i = sz; i < lstsize; i++) {
             // of course, copy assignment of type T should be supported...duh!!!
             elems[i] = T {};
         }
@@ -245,37 +454,61 @@ void Vector<T>::resize(int sz)
     lstsize = sz;
 }
 
-template <typename T>
-void Vector<T>::clear () {
+template <typename T, int N>
+void Vector<T, N>::resize(index_t sz, uninitialized_t)
+{
+    static_assert(std::is_trivially_default_constructible_v<T> && std::is_trivially_destructible_v<T>,
+                  "only trivial types can be left uninitialized");
+    if (sz > arsize) {
+        change_len(grown_capacity(sz));
+    }
+    lstsize = sz;
+}
+
+template <typename T, int N>
+void Vector<T, N>::reserve(index_t cap)
+{
+    if (cap > arsize)
+        change_len(cap);
+}
+
+template <typename T, int N>
+void Vector<T, N>::shrink_to_fit()
+{
+    change_len(std::max(lstsize, index_t {1}));
+}
+
+template <typename T, int N>
+void Vector<T, N>::clear () {
 
-    // for (int i = 0; i < lstsize; i++) { 
-    //     elems[i] = T {}; 
-    // } 
-    // lstsize = 0; 
+    // for (index_t i = 0; i < lstsize; i++) {
+    //     elems[i] = T {};
+    // }
+    // lstsize = 0;
 
     this->resize(0);
 }
 
-template <typename T>
-T& Vector<T>::operator[] (int index) {
+template <typename T, int N>
+T& Vector<T, N>::operator[] (index_t index) {
     checkindex(index);
     return elems[index];
 }
 
-template <typename T>
-const T& Vector<T>::operator[] (int index) const {
+template <typename T, int N>
+const T& Vector<T, N>::operator[] (index_t index) const {
     checkindex(index);
     return elems[index];
 }
 
-template <typename T>
-void Vector<T>::checkindex (int index) const {
+template <typename T, int N>
+void Vector<T, N>::checkindex (index_t index) const {
     if (index < 0 || index >= lstsize)
         throw std::length_error("Invalid index");
 }
 
-template<typename T>
-std::ostream& operator<<(std::ostream& out, Vector<T> ar) {
+template<typename T, int N>
+std::ostream& operator<<(std::ostream& out, const Vector<T, N>& ar) {
     out << "array_list[" << ar.size() << "/" << ar.capacity() << "]: ";
     ar.output(out);
     return out;
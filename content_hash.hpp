@@ -0,0 +1,75 @@
+#pragma once
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+/*
+ * Content hash behind matrix<T>::content_hash(): the sum (mod 2^64) of a
+ * strong 64-bit mix of every element's bits and position, finalized together
+ * with the shape. Each element is hashed independently, so the sum
+ * vectorizes, splits across threads and can be updated in place when a
+ * single element changes. Elements wider than 64 bits (long double) are
+ * hashed one 8-byte word at a time.
+ */
+static inline std::uint64_t fmix64 (std::uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// bytes of T that hold its value: the x87 80-bit long double is stored in
+// 12 or 16 bytes whose tail is padding with unspecified contents
+template <typename T>
+constexpr std::size_t value_bytes ()
+{
+    if constexpr (std::floating_point<T>) {
+        if (std::numeric_limits<T>::digits == 64 && sizeof(T) > 10)
+            return 10;
+    }
+    return sizeof(T);
+}
+
+// hash of element x stored at flat position i
+template <typename T>
+static inline std::uint64_t element_hash (std::int64_t i, T x)
+{
+    if constexpr (std::floating_point<T>) {
+        if (x == 0)
+            x = 0;      // -0.0 == 0.0, so they must hash alike
+    }
+    constexpr std::size_t n = value_bytes<T>();
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&x);
+    std::uint64_t bits = 0;
+    std::memcpy(&bits, bytes, n < 8 ? n : 8);
+    std::uint64_t h = fmix64(bits + static_cast<std::uint64_t>(i + 1) * 0x9e3779b97f4a7c15ULL);
+    // the remaining words, chained so that their order matters
+    for (std::size_t k = 8; k < n; k += 8) {
+        std::uint64_t word = 0;
+        std::memcpy(&word, bytes + k, n - k < 8 ? n - k : 8);
+        h = fmix64(h ^ (word + 0x9e3779b97f4a7c15ULL));
+    }
+    return h;
+}
+
+// sum of element_hash over p[0..n), where p[0] sits at flat position first
+template <typename T>
+static std::uint64_t elems_hash (const T* p, std::int64_t n, std::int64_t first = 0)
+{
+    std::uint64_t h = 0;
+    for (std::int64_t k = 0; k < n; ++k)
+        h += element_hash(first + k, p[k]);
+    return h;
+}
+
+// folds the shape into h: rows in the high word, columns in the low one
+// (column counts of 2^32 and up overlap the rows' bits)
+static inline std::uint64_t finalize_hash (std::uint64_t h, std::int64_t nrows, std::int64_t nclms)
+{
+    return fmix64(h ^ fmix64((static_cast<std::uint64_t>(nrows) << 32) ^ static_cast<std::uint64_t>(nclms)));
+}
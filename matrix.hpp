@@ -1,21 +1,101 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
 #include <iostream>
 #include <stdexcept>
+#include <system_error>
 #include <cstring>
 #include <concepts>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 #include "Vector.hpp"
+#include "content_hash.hpp"
+#include "numa.hpp"
+#include "parallel.hpp"
+
+// nrows * nclms, or std::length_error if that many elements of T would not
+// be addressable with index_t
+template <typename T>
+static index_t checked_size (index_t nrows, index_t nclms)
+{
+    const index_t limit = std::numeric_limits<index_t>::max() / static_cast<index_t>(sizeof(T));
+    if (nclms != 0 && nrows > limit / nclms)
+        throw std::length_error ("matrix dimensions are too large");
+    return nrows * nclms;
+}
+
+// Shapes and offsets are index_t. The elementwise and product kernels still
+// index with int when every offset they form fits in 32 bits, so the hot
+// loops keep their narrower address arithmetic on ordinary sizes.
+static inline bool fits_int32 (index_t n)
+{
+    return n <= std::numeric_limits<std::int32_t>::max();
+}
 
 template <typename T> 
 requires std::integral<T> || std::floating_point<T>
 class matrix {
     private:
-        int nrows;
-        int nclms;
-        // flattening a 2D matrix to a 1D vector
+        index_t nrows;
+        index_t nclms;
+        index_t ld;     // row stride: elements between the starts of consecutive rows, >= nclms
+        // flattening a 2D matrix to a 1D vector; row r (0-based) starts at
+        // r * ld, the ld - nclms padding slots at the end of each row hold T {}
         Vector<T> elems;
 
+        // Per-row content hashes, only allocated while the hash is tracked
+        struct hash_state {
+            Vector<std::uint64_t> row_hash;     // sum of element hashes of each row
+            Vector<unsigned char> row_dirty;    // rows whose row_hash is stale
+            std::atomic<bool> dirty {false};    // any row_dirty set
+            std::uint64_t total = 0;            // sum of row_hash, valid while !dirty
+            mutable std::mutex refresh;         // held while content_hash() rehashes stale rows
+
+            hash_state () = default;
+            hash_state (const hash_state& s)
+            {
+                std::lock_guard<std::mutex> guard {s.refresh};
+                row_hash = s.row_hash;
+                row_dirty = s.row_dirty;
+                dirty = s.dirty.load();
+                total = s.total;
+            }
+        };
+        mutable std::unique_ptr<hash_state> hstate;
+
+        void touch_row (index_t row)
+        {
+            if (hstate) {
+                hstate->row_dirty[row - 1] = 1;
+                // writers never overlap content_hash(), so no ordering is needed
+                hstate->dirty.store(true, std::memory_order_relaxed);
+            }
+        };
+        void touch_rows (index_t first_row);
+        void touch_all () {touch_rows(1);};
+        void restride (index_t nld);
+        void ensure_padding ();
+        void check_line (const Vector<T>& values, index_t n) const;
+        template <typename F>
+        void update_elems (const matrix<T>& a, F f);
+        void take_hash_state (std::unique_ptr<hash_state> hs);
+
     public:
         // default constructor
-        matrix (int nrows = 10, int nclms = 10);
+        matrix (index_t nrows = 10, index_t nclms = 10);
+        // Elements are left unwritten, and the pages of a large matrix are
+        // not even touched: each lands on the NUMA node of whichever thread
+        // writes it first.
+        matrix (index_t nrows, index_t nclms, uninitialized_t);
+        // Zeroed, with the pages placed by policy (see numa.hpp) and written
+        // in parallel by the same row chunks, on the same CPUs when threads
+        // are pinned (see parallel.hpp), that the row-parallel kernels use.
+        // std::system_error if the kernel refuses the placement.
+        matrix (index_t nrows, index_t nclms, numa_policy policy, int node = 0);
         ~matrix ();
 
         // copy and move constructors/initialization
@@ -25,17 +105,68 @@ class matrix {
         // copy and move assignment
         matrix<T>& operator =(const matrix<T>& a);
         matrix<T>& operator =(matrix<T>&& a);
+        // exchanges contents, shape and hash tracking with a in O(1)
+        void swap (matrix<T>& a) noexcept;
 
         // printing with m,n value
         void print ();
 
-        int rows() const {return nrows;};
-        int columns() const {return nclms;};
+        index_t rows() const {return nrows;};
+        index_t columns() const {return nclms;};
+        // distance between the starts of consecutive rows in data()
+        index_t stride() const {return ld;};
+        // no padding between rows, data() holds rows() * columns() elements back to back
+        bool contiguous() const {return ld == nclms;};
+        // elements the storage has room for: rows() * stride() plus any
+        // reserved capacity
+        index_t capacity() const {return elems.capacity();};
+
+        // row-major storage, element (row, clm) at (row-1)*stride() + (clm-1)
+        // (writable access marks every row as modified for the tracked hash)
+        T* data() {touch_all(); return elems.data();};
+        const T* data() const {return elems.data();};
+
+        // Growing and shrinking in place. Positions are 1-based and
+        // insert_*(k, values) makes values the new row/column k.
+        // Rows are appended into the reserved capacity (amortized O(columns)).
+        // Columns are written into the padding at the end of each row; when
+        // there is none left the stride doubles, so only O(log n) column
+        // appends relayout the whole matrix. An empty matrix takes its other
+        // dimension from the first row/column added; erasing the last
+        // row/column leaves a 0 x 0 matrix.
+        void reserve (index_t nrows, index_t nclms);
+        void append_row (const Vector<T>& values) {insert_row(nrows + 1, values);};
+        void insert_row (index_t row, const Vector<T>& values);
+        void erase_row (index_t row);
+        void append_column (const Vector<T>& values) {insert_column(nclms + 1, values);};
+        void insert_column (index_t clm, const Vector<T>& values);
+        void erase_column (index_t clm);
+        // drops the row padding and the unused reserved capacity
+        void shrink_to_fit ();
+
+        // 64-bit hash of shape and contents; equal matrices hash alike.
+        // Untracked matrices hash every element on each call. Tracked ones
+        // keep per-row hashes and only rehash rows modified since the last
+        // call: the non-const operator() and data() mark rows stale, += and
+        // -= rehash in the same pass that updates the elements.
+        // A row is marked when the reference or pointer is handed out, not
+        // when it is written through: do not keep a T& from operator() or a
+        // T* from data() across a content_hash() call (or a matrix_cache
+        // lookup) and write through it afterwards. Take it again instead.
+        // Tracking belongs to the object: copies start with the source's
+        // setting, assignments keep the target's. Like any const member,
+        // content_hash() may run on several threads at once: the first to
+        // find stale rows rehashes them under a lock while the others wait.
+        // Every element type hashes, long double included (only the bytes
+        // that hold its value count, not the padding after them).
+        void track_content_hash (bool on = true);
+        bool content_hash_tracked () const {return hstate != nullptr;};
+        std::uint64_t content_hash () const;
 
         matrix<T> transpose () const;
         // 1 <= row <= nrows and 1 <= clm <= nclms;
-        T& operator () (int row, int clm);
-        const T& operator () (int row, int clm) const;
+        T& operator () (index_t row, index_t clm);
+        const T& operator () (index_t row, index_t clm) const;
 
         // Arithmatic operations
         matrix<T> operator +() const; // Unary +
@@ -52,7 +183,13 @@ class matrix {
 };
 
 template <typename T>
-matrix<T>::matrix (int nrows, int nclms)
+matrix<T>::matrix (index_t nrows, index_t nclms) : matrix(nrows, nclms, uninitialized)
+{
+    std::fill(elems.begin(), elems.end(), T {});
+}
+
+template <typename T>
+matrix<T>::matrix (index_t nrows, index_t nclms, uninitialized_t)
 {
     if (nrows < 0 || nclms < 0) {
         throw std::invalid_argument ("number of rows and columns must be non-negative value");
@@ -69,9 +206,21 @@ matrix<T>::matrix (int nrows, int nclms)
     // else size = nclms*nrows;
 
     // elems = Vector<T>{size};
-    elems.resize(nrows * nclms);
+    elems.resize_exact(checked_size<T>(nrows, nclms), uninitialized);
     this->nrows = nrows;
     this->nclms = nclms;
+    ld = nclms;
+}
+
+template <typename T>
+matrix<T>::matrix (index_t nrows, index_t nclms, numa_policy policy, int node) : matrix(nrows, nclms, uninitialized)
+{
+    if (!numa_place(elems.data(), sizeof(T) * elems.capacity(), policy, node))
+        throw std::system_error (errno, std::generic_category(), "NUMA placement failed");
+    T* p = elems.data();
+    parallel_for(nrows, parallel_row_grain(nclms), [&](int, index_t begin, index_t end) {
+        std::fill(p + begin * ld, p + end * ld, T {});
+    });
 }
 
 template <typename T>
@@ -82,13 +231,11 @@ matrix<T>::~matrix ()
 
 // Copy constructor
 template <typename T>
-matrix<T>::matrix (const matrix<T>& a)
+matrix<T>::matrix (const matrix<T>& a) : nrows(a.nrows), nclms(a.nclms), ld(a.ld), elems(a.elems)
 {
     std::cout << "Enter Copy constructor\n";
-    elems.resize(a.nrows * a.nclms);
-    elems = a.elems;
-    nrows = a.nrows;
-    nclms = a.nclms;
+    if (a.hstate)
+        hstate = std::make_unique<hash_state>(*a.hstate);
 }
 
 // Move constructors
@@ -98,8 +245,10 @@ matrix<T>::matrix (matrix<T>&& a)
     std::cout << "Enter move constructor\n";
     nrows = a.nrows;
     nclms = a.nclms;
+    ld = a.ld;
     elems = std::move(a.elems);
-    a.nrows = a.nclms = 0;
+    hstate = std::move(a.hstate);
+    a.nrows = a.nclms = a.ld = 0;
 }
 
 // Copy assignment
@@ -110,9 +259,30 @@ matrix<T>& matrix<T>::operator = (const matrix<T>& a)
     elems = a.elems;
     nrows = a.nrows;
     nclms = a.nclms;
+    ld = a.ld;
+    if (hstate)
+        take_hash_state(a.hstate ? std::make_unique<hash_state>(*a.hstate) : nullptr);
     return *this;
 }
 
+template <typename T>
+void matrix<T>::swap (matrix<T>& a) noexcept
+{
+    std::swap(nrows, a.nrows);
+    std::swap(nclms, a.nclms);
+    std::swap(ld, a.ld);
+    std::swap(elems, a.elems);
+    std::swap(hstate, a.hstate);
+}
+
+// found by `using std::swap; swap(a, b);`, which would otherwise go through
+// the move constructor and assignments
+template <typename T>
+void swap (matrix<T>& a, matrix<T>& b) noexcept
+{
+    a.swap(b);
+}
+
 // Move assignment
 template <typename T>
 matrix<T>& matrix<T>::operator = (matrix<T>&& a)
@@ -121,17 +291,175 @@ matrix<T>& matrix<T>::operator = (matrix<T>&& a)
 
     nrows = a.nrows;
     nclms = a.nclms;
+    ld = a.ld;
     elems = std::move(a.elems);
-    a.nrows = a.nclms = 0;
+    if (hstate)
+        take_hash_state(std::move(a.hstate));
+    a.hstate.reset();
+    a.nrows = a.nclms = a.ld = 0;
     return *this;
 }
 
+// Tracked hash: rows first_row..nrows become stale (after a change of shape
+// the per-row arrays are resized to match)
+template <typename T>
+void matrix<T>::touch_rows (index_t first_row)
+{
+    if (!hstate)
+        return;
+    hstate->row_hash.resize(nrows);
+    hstate->row_dirty.resize(nrows);
+    if (first_row <= nrows)
+        std::fill(hstate->row_dirty.begin() + first_row - 1, hstate->row_dirty.end(), 1);
+    // the total is stale even with no row left to rehash: erasing the last
+    // row still removes that row's hash from it
+    hstate->dirty.store(true, std::memory_order_relaxed);
+}
+
+// Adopt hs as the tracked state of the current contents, or start over with
+// every row stale when there is none
+template <typename T>
+void matrix<T>::take_hash_state (std::unique_ptr<hash_state> hs)
+{
+    if (hs) {
+        hstate = std::move(hs);
+    } else {
+        hstate = std::make_unique<hash_state>();
+        touch_all();
+    }
+}
+
+// p[i, j] = f(p[i, j], q[i, j]) over nr x nc elements
+template <typename I, typename T, typename F>
+static void update_kernel (T* p, index_t ldp, const T* q, index_t ldq, index_t nr, index_t nc, F f)
+{
+    const I n = static_cast<I>(nc);
+    for (I i = 0; i < static_cast<I>(nr); ++i) {
+        T* pi = p + i * static_cast<I>(ldp);
+        const T* qi = q + i * static_cast<I>(ldq);
+        for (I j = 0; j < n; ++j)
+            pi[j] = f(pi[j], qi[j]);
+    }
+}
+
+// c += a * b for row-major a (n x m), b (m x k) and c (n x k) with row
+// strides lda, ldb, ldc. The i-k-j order streams rows of b and c through
+// the inner loop, and each c(i, j) still sums its products in k order.
+template <typename I, typename T>
+static void multiply_kernel (const T* a, index_t lda, const T* b, index_t ldb, T* c, index_t ldc,
+                             index_t n, index_t m, index_t k)
+{
+    for (I i = 0; i < static_cast<I>(n); ++i) {
+        T* ci = c + i * static_cast<I>(ldc);
+        const T* ai = a + i * static_cast<I>(lda);
+        for (I l = 0; l < static_cast<I>(m); ++l) {
+            const T x = ai[l];
+            const T* bl = b + l * static_cast<I>(ldb);
+            for (I j = 0; j < static_cast<I>(k); ++j)
+                ci[j] += x * bl[j];
+        }
+    }
+}
+
+// elems[i] = f(elems[i], a.elems[i]); a tracked hash is refreshed row by row
+// in the same pass
+template <typename T>
+template <typename F>
+void matrix<T>::update_elems (const matrix<T>& a, F f)
+{
+    T* p = elems.data();
+    const T* q = a.elems.data();
+    if (!hstate) {
+        // a packed matrix is a single row of nrows * nclms elements
+        const bool flat = contiguous() && a.contiguous();
+        const index_t nr = flat ? 1 : nrows;
+        const index_t nc = flat ? nrows * nclms : nclms;
+        if (fits_int32(nrows * std::max(ld, a.ld)))
+            update_kernel<int>(p, ld, q, a.ld, nr, nc, f);
+        else
+            update_kernel<index_t>(p, ld, q, a.ld, nr, nc, f);
+        return;
+    }
+
+    std::uint64_t* rh = hstate->row_hash.data();
+    hstate->total = 0;
+    for (index_t i = 0; i < nrows; ++i) {
+        T* pi = p + i * ld;
+        const T* qi = q + i * a.ld;
+        std::uint64_t h = 0;
+        for (index_t j = 0; j < nclms; ++j) {
+            pi[j] = f(pi[j], qi[j]);
+            h += element_hash(std::int64_t(i) * nclms + j, pi[j]);
+        }
+        rh[i] = h;
+        hstate->total += h;
+    }
+    std::fill(hstate->row_dirty.begin(), hstate->row_dirty.end(), 0);
+    hstate->dirty = false;
+}
+
+template <typename T>
+void matrix<T>::track_content_hash (bool on)
+{
+    if (!on)
+        hstate.reset();
+    else if (!hstate)
+        take_hash_state(nullptr);
+}
+
+template <typename T>
+std::uint64_t matrix<T>::content_hash () const
+{
+    const T* p = elems.data();
+    // hashes use the logical position i * nclms + j, so padding does not matter
+    const index_t grain = parallel_row_grain(nclms);
+    if (!hstate) {
+        std::vector<std::uint64_t> partial(parallel_chunks(nrows, grain));
+        parallel_for(nrows, grain, [&](int c, index_t begin, index_t end) {
+            if (contiguous()) {
+                partial[c] = elems_hash(p + begin * nclms, (end - begin) * nclms, std::int64_t(begin) * nclms);
+                return;
+            }
+            partial[c] = 0;
+            for (index_t i = begin; i < end; ++i)
+                partial[c] += elems_hash(p + i * ld, nclms, std::int64_t(i) * nclms);
+        });
+
+        std::uint64_t h = 0;
+        for (auto s : partial)
+            h += s;
+        return finalize_hash(h, nrows, nclms);
+    }
+
+    if (hstate->dirty.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> guard {hstate->refresh};
+        if (!hstate->dirty.load(std::memory_order_relaxed))
+            return finalize_hash(hstate->total, nrows, nclms);     // refreshed by another thread
+        std::uint64_t* rh = hstate->row_hash.data();
+        unsigned char* rd = hstate->row_dirty.data();
+        parallel_for(nrows, grain, [&](int, index_t begin, index_t end) {
+            for (index_t i = begin; i < end; ++i) {
+                if (rd[i]) {
+                    rh[i] = elems_hash(p + i * ld, nclms, std::int64_t(i) * nclms);
+                    rd[i] = 0;
+                }
+            }
+        });
+        hstate->total = 0;
+        for (index_t i = 0; i < nrows; ++i)
+            hstate->total += rh[i];
+        hstate->dirty.store(false, std::memory_order_release);
+    }
+    return finalize_hash(hstate->total, nrows, nclms);
+}
+
 template <typename T>
 void matrix<T>::print ()
 {
-    for (int i = 1; i <= nrows; ++i) {
-        for (int j = 1; j <= nclms; ++j) {
-            std::cout << this->operator()(i,j) << "\t";
+    const matrix<T>& self = *this;
+    for (index_t i = 1; i <= nrows; ++i) {
+        for (index_t j = 1; j <= nclms; ++j) {
+            std::cout << self(i,j) << "\t";
         }
         std::cout << std::endl;
     }
@@ -144,8 +472,8 @@ matrix<T> matrix<T>::transpose () const
     // writing result into new matrix
     matrix<T> mt {nclms, nrows};
 
-    for (int i = 1; i <= nrows; ++i) {
-        for (int j = 1; j <= nclms; ++j) {
+    for (index_t i = 1; i <= nrows; ++i) {
+        for (index_t j = 1; j <= nclms; ++j) {
             mt(j, i) = (*this)(i, j);
         }
     }
@@ -153,17 +481,19 @@ matrix<T> matrix<T>::transpose () const
 }
 
 template <typename T>
-T& matrix<T>::operator () (int row, int clm)
+T& matrix<T>::operator () (index_t row, index_t clm)
 {
     // accessing row and then column within the 1D vector
-    int idx = (row - 1) * nclms + (clm - 1);
-    return this->elems[idx];
+    index_t idx = (row - 1) * ld + (clm - 1);
+    T& elem = this->elems[idx];
+    touch_row(row);
+    return elem;
 }
 
 template <typename T>
-const T& matrix<T>::operator () (int row, int clm) const
+const T& matrix<T>::operator () (index_t row, index_t clm) const
 {
-    int idx = (row - 1) * nclms + (clm - 1);
+    index_t idx = (row - 1) * ld + (clm - 1);
     return this->elems[idx];
 }
 
@@ -188,19 +518,22 @@ matrix<T>& matrix<T>::operator +=(const matrix<T>& a)
         throw std::invalid_argument ("number of rows and/or columns are not the same");
     }
 
-    int nitems = nrows * nclms;
-    for (int i = 0; i < nitems; ++i)
-        elems[i] += a.elems[i];
-
+    update_elems(a, [](T x, T y) {return x + y;});
     return *this;
 }
 
 template <typename T>
 matrix<T> matrix<T>::operator -()   // negates all values in matrix
 {
-    int nitems = nrows * nclms;
-    for (int i = 0; i < nitems; ++i)
-        elems[i] = -elems[i];    
+    // row by row, so the padding keeps T {} (negating it would turn a
+    // floating-point 0.0 into -0.0)
+    T* p = elems.data();
+    for (index_t i = 0; i < nrows; ++i) {
+        T* pi = p + i * ld;
+        for (index_t j = 0; j < nclms; ++j)
+            pi[j] = -pi[j];
+    }
+    touch_all();
     return *this;
 }
 
@@ -219,47 +552,207 @@ matrix<T>& matrix<T>::operator -=(const matrix<T>& a)
         throw std::invalid_argument ("number of rows and/or columns are not the same");
     }
 
-    int nitems = nrows * nclms;
-    for (int i = 0; i < nitems; ++i)
-        elems[i] -= a.elems[i];
-
+    update_elems(a, [](T x, T y) {return x - y;});
     return *this;
 }
 
 template <typename T>
 matrix<T> matrix<T>::operator *(const matrix<T>& a) const
 {
-    matrix<T> mr {nrows, a.nclms};
-
     if (nclms != a.nrows) {
         throw std::invalid_argument ("number of rows/columns mismatch");
     }
-    // basic matrix multiplication
-    for (int i = 1; i <= nrows; ++i) {
-        for (int j = 1; j <= a.nclms; ++j) {
-            int val = 0;
-            for (int k = 1; k <= nclms; ++k) {
-                val += (*this)(i, k) * a(k, j);
-            }
-            mr(i, j) = val;
-        }
-    }
+    // the constructor rejects a result shape that overflows
+    matrix<T> mr {nrows, a.nclms};
+
+    const T* p = elems.data();
+    const T* q = a.elems.data();
+    T* r = mr.elems.data();
+    if (fits_int32(nrows * ld) && fits_int32(a.nrows * a.ld) && fits_int32(mr.nrows * mr.ld))
+        multiply_kernel<int>(p, ld, q, a.ld, r, mr.ld, nrows, nclms, a.nclms);
+    else
+        multiply_kernel<index_t>(p, ld, q, a.ld, r, mr.ld, nrows, nclms, a.nclms);
 
     return mr;
 }
 
+#define MATRIX_CMP_BLOCK    256     // elements compared between early-exit checks
+
+// true if p[0..n) and q[0..n) compare equal element by element (so -0.0 == 0.0
+// and NaN != NaN). Each block is compared without branching so the loop
+// vectorizes; the first mismatching block ends the scan.
+template <typename T>
+static bool elems_equal (const T* p, const T* q, index_t n)
+{
+    if (n == 0)
+        return true;
+
+    if constexpr (std::integral<T>) {
+        return std::memcmp(p, q, sizeof(T) * n) == 0;
+    } else {
+        for (index_t i = 0; i < n; i += MATRIX_CMP_BLOCK) {
+            const index_t end = std::min(n, i + MATRIX_CMP_BLOCK);
+            bool diff = false;
+            for (index_t k = i; k < end; ++k)
+                diff |= (p[k] != q[k]);
+            if (diff)
+                return false;
+        }
+        return true;
+    }
+}
+
 template <typename T>
 bool matrix<T>::operator == (const matrix<T>& a) const
 {
     if ((nrows != a.nrows) || (nclms != a.nclms))
         return false;
 
-    for (int i = 1; i <= nrows; ++i) {
-        for (int j = 1; j <= nclms; ++j) {
-            if ((*this)(i, j) != a(i, j))
-                return false;
-        }
+    if (contiguous() && a.contiguous())
+        return elems_equal(data(), a.data(), nrows * nclms);
+    for (index_t i = 0; i < nrows; ++i) {
+        if (!elems_equal(data() + i * ld, a.data() + i * a.ld, nclms))
+            return false;
     }
     return true;
 }
 
+// Moves every row to stride nld in place, keeping the padding zeroed
+template <typename T>
+void matrix<T>::restride (index_t nld)
+{
+    if (nld == ld)
+        return;
+
+    if (nld > ld) {
+        // rows move towards the end, so go from the last one backwards; the
+        // stride already grows geometrically, so the storage is sized exactly
+        elems.resize_exact(checked_size<T>(nrows, nld));
+        T* p = elems.data();
+        for (index_t i = nrows - 1; i >= 0; --i) {
+            std::copy_backward(p + i * ld, p + i * ld + nclms, p + i * nld + nclms);
+            std::fill(p + i * nld + nclms, p + (i + 1) * nld, T {});
+        }
+    } else {
+        T* p = elems.data();
+        for (index_t i = 1; i < nrows; ++i)
+            std::copy(p + i * ld, p + i * ld + nclms, p + i * nld);
+        elems.resize(nrows * nld);
+    }
+    ld = nld;
+}
+
+// Room for one more column at the end of every row
+template <typename T>
+void matrix<T>::ensure_padding ()
+{
+    if (nclms == ld)
+        restride(std::max(index_t {1}, 2 * ld));
+}
+
+template <typename T>
+void matrix<T>::check_line (const Vector<T>& values, index_t n) const
+{
+    if (values.size() != n)
+        throw std::invalid_argument ("number of values does not match the matrix dimension");
+}
+
+template <typename T>
+void matrix<T>::reserve (index_t nrows, index_t nclms)
+{
+    if (nrows < 0 || nclms < 0)
+        throw std::invalid_argument ("number of rows and columns must be non-negative value");
+
+    const index_t nitems = checked_size<T>(nrows, std::max(nclms, ld));
+    if (nclms > ld)
+        restride(nclms);
+    elems.reserve(nitems);
+}
+
+template <typename T>
+void matrix<T>::insert_row (index_t row, const Vector<T>& values)
+{
+    if (row < 1 || row > nrows + 1)
+        throw std::length_error ("Invalid index");
+    if (nrows == 0) {
+        if (values.size() == 0)
+            throw std::invalid_argument ("Either both rows and columns should be zero OR non-zero");
+        nclms = ld = values.size();
+    }
+    check_line(values, nclms);
+
+    elems.resize(checked_size<T>(nrows + 1, ld));
+    T* p = elems.data();
+    std::copy_backward(p + (row - 1) * ld, p + nrows * ld, p + (nrows + 1) * ld);
+    std::copy(values.begin(), values.end(), p + (row - 1) * ld);
+    std::fill(p + (row - 1) * ld + nclms, p + row * ld, T {});
+    ++nrows;
+    touch_rows(row);
+}
+
+template <typename T>
+void matrix<T>::erase_row (index_t row)
+{
+    if (row < 1 || row > nrows)
+        throw std::length_error ("Invalid index");
+
+    T* p = elems.data();
+    std::copy(p + row * ld, p + nrows * ld, p + (row - 1) * ld);
+    --nrows;
+    if (nrows == 0)
+        nclms = ld = 0;
+    elems.resize(nrows * ld);
+    touch_rows(row);
+}
+
+template <typename T>
+void matrix<T>::insert_column (index_t clm, const Vector<T>& values)
+{
+    if (clm < 1 || clm > nclms + 1)
+        throw std::length_error ("Invalid index");
+    if (nclms == 0) {
+        if (values.size() == 0)
+            throw std::invalid_argument ("Either both rows and columns should be zero OR non-zero");
+        // the stride may already be reserved: lay the rows out at it, all padding
+        elems.resize(checked_size<T>(values.size(), ld));
+        nrows = values.size();
+    }
+    check_line(values, nrows);
+
+    ensure_padding();
+    T* p = elems.data();
+    for (index_t i = 0; i < nrows; ++i) {
+        T* pi = p + i * ld;
+        std::copy_backward(pi + clm - 1, pi + nclms, pi + nclms + 1);
+        pi[clm - 1] = values[i];
+    }
+    ++nclms;
+    touch_all();
+}
+
+template <typename T>
+void matrix<T>::erase_column (index_t clm)
+{
+    if (clm < 1 || clm > nclms)
+        throw std::length_error ("Invalid index");
+
+    T* p = elems.data();
+    for (index_t i = 0; i < nrows; ++i) {
+        T* pi = p + i * ld;
+        std::copy(pi + clm, pi + nclms, pi + clm - 1);
+        pi[nclms - 1] = T {};
+    }
+    --nclms;
+    if (nclms == 0) {
+        nrows = ld = 0;
+        elems.resize(0);
+    }
+    touch_all();
+}
+
+template <typename T>
+void matrix<T>::shrink_to_fit ()
+{
+    restride(nclms);
+    elems.shrink_to_fit();
+}
@@ -0,0 +1,171 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "matrix.hpp"
+
+// Opt-in memoization of matrix results keyed by operand content.
+//
+//      matrix_cache<double> cache {512 << 20};      // keep up to 512 MiB of results
+//      auto c = cache.multiply(a, b);               // shared_ptr<const matrix<double>>
+//
+// Results are keyed by (operation, content_hash() of every operand) and kept
+// in least-recently-used order until their total size exceeds the byte
+// budget. Enable track_content_hash() on long-lived operands so a lookup does
+// not have to rehash them. Keys are 64-bit hashes per operand, so a collision
+// would return a wrong result; the odds are negligible for non-adversarial data.
+// With tracking on, never write to an operand through a reference or pointer
+// obtained before the previous lookup (see matrix<T>::track_content_hash()):
+// the write goes unnoticed and the lookup returns the stale result.
+//
+// All members are thread-safe, and threads may look up with the same
+// operands, tracked or not: a tracked operand's stale rows are rehashed by
+// one of them (see matrix<T>::content_hash()). Results are computed outside
+// the lock, so two threads missing on the same key at once may both compute it.
+
+// operation ids used by matrix_cache; user-defined operations passed to
+// get_or_compute should use values from MATRIX_CACHE_OP_USER upwards
+#define MATRIX_CACHE_OP_MULTIPLY    1
+#define MATRIX_CACHE_OP_USER        1024
+
+template <typename T>
+class matrix_cache {
+    public:
+        struct stats {
+            std::uint64_t hits = 0;
+            std::uint64_t misses = 0;
+            std::uint64_t evictions = 0;
+            std::size_t entries = 0;
+            std::size_t bytes = 0;
+        };
+
+        explicit matrix_cache (std::size_t capacity_bytes);
+
+        // a * b
+        std::shared_ptr<const matrix<T>> multiply (const matrix<T>& a, const matrix<T>& b);
+
+        // compute(a, b) for operation op, e.g. a decomposition with b unused
+        template <typename F>
+        std::shared_ptr<const matrix<T>> get_or_compute (std::uint64_t op, const matrix<T>& a,
+                                                         const matrix<T>& b, F compute);
+
+        stats statistics () const;
+        std::size_t capacity () const {return capacity_bytes;};
+        void clear ();
+
+    private:
+        struct key {
+            std::uint64_t op;
+            std::uint64_t ha;
+            std::uint64_t hb;
+            bool operator ==(const key&) const = default;
+        };
+        struct key_hash {
+            std::size_t operator () (const key& k) const
+            {
+                return fmix64(k.op ^ fmix64(k.ha ^ fmix64(k.hb)));
+            };
+        };
+        struct entry {
+            key k;
+            std::shared_ptr<const matrix<T>> result;
+            std::size_t bytes;
+        };
+
+        // what the result really holds on to: row padding and spare
+        // capacity included
+        static std::size_t footprint (const matrix<T>& m)
+        {
+            return sizeof(matrix<T>) + sizeof(T) * m.capacity();
+        };
+        void evict_to (std::size_t budget);
+
+        std::size_t capacity_bytes;
+        std::size_t used_bytes = 0;
+        std::list<entry> lru;       // most recently used first
+        std::unordered_map<key, typename std::list<entry>::iterator, key_hash> index;
+        stats counters;
+        mutable std::mutex lock;
+};
+
+template <typename T>
+matrix_cache<T>::matrix_cache (std::size_t capacity_bytes) : capacity_bytes(capacity_bytes)
+{
+}
+
+template <typename T>
+std::shared_ptr<const matrix<T>> matrix_cache<T>::multiply (const matrix<T>& a, const matrix<T>& b)
+{
+    return get_or_compute(MATRIX_CACHE_OP_MULTIPLY, a, b,
+                          [](const matrix<T>& x, const matrix<T>& y) {return x * y;});
+}
+
+template <typename T>
+template <typename F>
+std::shared_ptr<const matrix<T>> matrix_cache<T>::get_or_compute (std::uint64_t op, const matrix<T>& a,
+                                                                  const matrix<T>& b, F compute)
+{
+    const key k {op, a.content_hash(), b.content_hash()};
+    {
+        std::lock_guard<std::mutex> guard {lock};
+        auto it = index.find(k);
+        if (it != index.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            ++counters.hits;
+            return it->second->result;
+        }
+        ++counters.misses;
+    }
+
+    auto result = std::make_shared<const matrix<T>>(compute(a, b));
+    const std::size_t bytes = footprint(*result);
+    if (bytes > capacity_bytes)
+        return result;
+
+    std::lock_guard<std::mutex> guard {lock};
+    auto it = index.find(k);
+    if (it != index.end()) {
+        // another thread got there first
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->result;
+    }
+    evict_to(capacity_bytes - bytes);
+    lru.push_front(entry {k, result, bytes});
+    index.emplace(k, lru.begin());
+    used_bytes += bytes;
+    return result;
+}
+
+// drop least recently used entries until at most budget bytes are used; lock held
+template <typename T>
+void matrix_cache<T>::evict_to (std::size_t budget)
+{
+    while (used_bytes > budget && !lru.empty()) {
+        used_bytes -= lru.back().bytes;
+        index.erase(lru.back().k);
+        lru.pop_back();
+        ++counters.evictions;
+    }
+}
+
+template <typename T>
+typename matrix_cache<T>::stats matrix_cache<T>::statistics () const
+{
+    std::lock_guard<std::mutex> guard {lock};
+    stats s = counters;
+    s.entries = lru.size();
+    s.bytes = used_bytes;
+    return s;
+}
+
+template <typename T>
+void matrix_cache<T>::clear ()
+{
+    std::lock_guard<std::mutex> guard {lock};
+    lru.clear();
+    index.clear();
+    used_bytes = 0;
+}
@@ -0,0 +1,233 @@
+#pragma once
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "matrix.hpp"
+
+// Products of several matrices without the cost of left-to-right evaluation.
+//
+//      multiply_chain(a, b, c, d)      -- a * b * c * d in the cheapest order
+//      multiply_chain(ms)              -- the same for a std::vector<matrix<T>>
+//      chain_cost(dims)                -- scalar multiplications that order takes
+//      pow(a, k)                       -- a^k of a square matrix, k >= 0
+//
+// a * b * c evaluates as (a * b) * c, whatever the shapes: with a 1000 x 1,
+// b 1 x 1000 and c 1000 x 1 that is 2 million multiplications where
+// a * (b * c) needs 2 thousand. multiply_chain picks the parenthesization
+// with the fewest multiplications (the textbook O(n^3) dynamic program over
+// the shapes) and evaluates it. Every product but the last goes into a pool
+// of workspace buffers that are handed back as soon as their value is
+// consumed, so a left-deep chain alternates between two of them.
+//
+// pow squares its way through the bits of k, O(log k) products, in three
+// n x n buffers that are swapped rather than reallocated.
+//
+// Results are the same as the corresponding operator * expression up to
+// floating-point reassociation across products; each element of each
+// product is still summed in the order operator * uses.
+
+// rows and columns of an operand or workspace buffer
+template <typename T>
+struct chain_operand {
+    const T* p;
+    index_t ld;
+    index_t nrows;
+    index_t nclms;
+};
+
+// c = a * b, overwriting c (row stride ldc)
+template <typename T>
+static void chain_multiply (const chain_operand<T>& a, const chain_operand<T>& b, T* c, index_t ldc)
+{
+    for (index_t i = 0; i < a.nrows; ++i)
+        std::fill(c + i * ldc, c + i * ldc + b.nclms, T {});
+    if (fits_int32(a.nrows * a.ld) && fits_int32(b.nrows * b.ld) && fits_int32(a.nrows * ldc))
+        multiply_kernel<int>(a.p, a.ld, b.p, b.ld, c, ldc, a.nrows, a.nclms, b.nclms);
+    else
+        multiply_kernel<index_t>(a.p, a.ld, b.p, b.ld, c, ldc, a.nrows, a.nclms, b.nclms);
+}
+
+// Optimal order of a chain of n = dims.size() - 1 matrices, matrix i being
+// dims[i] x dims[i + 1]. Costs are counted in double, since the product of
+// three large dimensions overflows 64 bits.
+struct chain_plan {
+    index_t n;
+    std::vector<double> cost;   // cost[i * n + j]: cheapest product of matrices i..j
+    std::vector<index_t> split; // split[i * n + j] = s: (i..s) * (s+1..j)
+
+    explicit chain_plan (const std::vector<index_t>& dims)
+        : n(static_cast<index_t>(dims.size()) - 1), cost(n * n), split(n * n)
+    {
+        for (index_t len = 2; len <= n; ++len) {
+            for (index_t i = 0; i + len <= n; ++i) {
+                const index_t j = i + len - 1;
+                double best = -1;
+                for (index_t s = i; s < j; ++s) {
+                    double c = cost[i * n + s] + cost[(s + 1) * n + j] +
+                               double(dims[i]) * double(dims[s + 1]) * double(dims[j + 1]);
+                    if (best < 0 || c < best) {
+                        best = c;
+                        split[i * n + j] = s;
+                    }
+                }
+                cost[i * n + j] = best;
+            }
+        }
+    }
+};
+
+// scalar multiplications of the optimal order for dims as in chain_plan
+inline double chain_cost (const std::vector<index_t>& dims)
+{
+    if (dims.size() < 2)
+        throw std::invalid_argument ("a chain needs at least one matrix");
+    const chain_plan plan {dims};
+    return plan.cost[plan.n - 1];
+}
+
+template <typename T>
+class chain_evaluator {
+    private:
+        const matrix<T>* const* ops;
+        const chain_plan& plan;
+        std::vector<Vector<T>> spare;   // workspace buffers not holding a live value
+
+        Vector<T> acquire (index_t size)
+        {
+            // the largest free buffer is the least likely to need growing
+            if (spare.empty()) {
+                Vector<T> buf;
+                buf.set_shrink_threshold(0);
+                buf.resize(size, uninitialized);
+                return buf;
+            }
+            auto it = std::max_element(spare.begin(), spare.end(),
+                [](const Vector<T>& x, const Vector<T>& y) {return x.capacity() < y.capacity();});
+            Vector<T> buf = std::move(*it);
+            spare.erase(it);
+            buf.resize(size, uninitialized);
+            return buf;
+        }
+
+        // value of matrices i..j; an operand is used in place, a product is
+        // left in a buffer appended to held
+        chain_operand<T> eval (index_t i, index_t j, std::vector<Vector<T>>& held)
+        {
+            if (i == j) {
+                const matrix<T>& m = *ops[i];
+                return {m.data(), m.stride(), m.rows(), m.columns()};
+            }
+            const index_t s = plan.split[i * plan.n + j];
+            std::vector<Vector<T>> inner;
+            const chain_operand<T> a = eval(i, s, inner);
+            const chain_operand<T> b = eval(s + 1, j, inner);
+            Vector<T> buf = acquire(a.nrows * b.nclms);
+            chain_multiply(a, b, buf.data(), b.nclms);
+            for (Vector<T>& v : inner)
+                spare.push_back(std::move(v));
+            held.push_back(std::move(buf));
+            return {held.back().data(), b.nclms, a.nrows, b.nclms};
+        }
+
+    public:
+        chain_evaluator (const matrix<T>* const* ops, const chain_plan& plan) : ops(ops), plan(plan) {}
+
+        matrix<T> run ()
+        {
+            const index_t n = plan.n;
+            if (n == 1)
+                return *ops[0];
+            const index_t s = plan.split[n - 1];
+            std::vector<Vector<T>> held;
+            const chain_operand<T> a = eval(0, s, held);
+            const chain_operand<T> b = eval(s + 1, n - 1, held);
+            // the constructor rejects a result shape that overflows
+            matrix<T> mr {a.nrows, b.nclms, uninitialized};
+            chain_multiply(a, b, mr.data(), mr.stride());
+            return mr;
+        }
+};
+
+template <typename T>
+static matrix<T> multiply_chain (const matrix<T>* const* ops, index_t n)
+{
+    if (n < 1)
+        throw std::invalid_argument ("a chain needs at least one matrix");
+    std::vector<index_t> dims(n + 1);
+    dims[0] = ops[0]->rows();
+    for (index_t i = 0; i < n; ++i) {
+        if (i > 0 && ops[i - 1]->columns() != ops[i]->rows())
+            throw std::invalid_argument ("number of rows/columns mismatch");
+        dims[i + 1] = ops[i]->columns();
+    }
+    const chain_plan plan {dims};
+    return chain_evaluator<T> {ops, plan}.run();
+}
+
+template <typename T, typename... M>
+requires (std::same_as<M, matrix<T>> && ...)
+matrix<T> multiply_chain (const matrix<T>& a, const M&... rest)
+{
+    const matrix<T>* ops[] = {&a, &rest...};
+    return multiply_chain<T>(ops, 1 + sizeof...(rest));
+}
+
+template <typename T>
+matrix<T> multiply_chain (const std::vector<matrix<T>>& ms)
+{
+    std::vector<const matrix<T>*> ops;
+    for (const matrix<T>& m : ms)
+        ops.push_back(&m);
+    return multiply_chain<T>(ops.data(), static_cast<index_t>(ops.size()));
+}
+
+// a^k by repeated squaring; a^0 is the identity
+template <typename T>
+matrix<T> pow (const matrix<T>& a, index_t k)
+{
+    if (a.rows() != a.columns())
+        throw std::invalid_argument ("matrix power needs a square matrix");
+    if (k < 0)
+        throw std::invalid_argument ("matrix power needs a non-negative exponent");
+
+    const index_t n = a.rows();
+    matrix<T> result {n, n};
+    if (k == 0) {
+        for (index_t i = 1; i <= n; ++i)
+            result(i, i) = T {1};
+        return result;
+    }
+
+    // base starts as a itself and result holds nothing until the lowest set
+    // bit of k; after that, each product goes into tmp, which is swapped in
+    matrix<T> base {n, n, uninitialized};
+    matrix<T> tmp {n, n, uninitialized};
+    auto view = [](const matrix<T>& m) {
+        return chain_operand<T> {m.data(), m.stride(), m.rows(), m.columns()};
+    };
+    chain_operand<T> b = view(a);
+    bool started = false;
+    for (;;) {
+        if (k & 1) {
+            if (started) {
+                chain_multiply(view(result), b, tmp.data(), tmp.stride());
+                result.swap(tmp);
+            } else {
+                T* r = result.data();
+                for (index_t i = 0; i < n; ++i)
+                    std::copy(b.p + i * b.ld, b.p + i * b.ld + n, r + i * result.stride());
+                started = true;
+            }
+        }
+        k >>= 1;
+        if (k == 0)
+            break;
+        chain_multiply(b, b, tmp.data(), tmp.stride());
+        base.swap(tmp);
+        b = view(base);
+    }
+    return result;
+}
@@ -0,0 +1,208 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include "matrix.hpp"
+#include "parallel.hpp"
+
+// Matrix comparison beyond operator ==
+//
+//      equal(a, b, exec::parallel)     -- operator == split across threads
+//      approx_equal(a, b, tol)         -- absolute / relative / ULP tolerance
+//      fingerprint(a)                  -- 64-bit content hash
+//
+// a == b implies fingerprint(a) == fingerprint(b) (-0.0 and 0.0 hash alike),
+// so differing fingerprints prove two matrices differ without comparing them.
+// Equal fingerprints only make equality very likely.
+
+enum class exec { serial, parallel };
+
+// Two elements x, y match if any enabled test passes:
+//      |x - y| <= abs
+//      |x - y| <= rel * max(|x|, |y|)
+//      x and y are at most ulps representable values apart
+// With everything 0 only exactly equal elements match. NaN never matches.
+struct tolerance {
+    double abs = 0;
+    double rel = 0;
+    std::int64_t ulps = 0;
+};
+
+// Position of x on a line where adjacent floating-point values are 1 apart
+// (for integral types the value itself)
+template <typename T>
+static std::int64_t ulp_ordinal (T x)
+{
+    if constexpr (std::integral<T>) {
+        return static_cast<std::int64_t>(x);
+    } else {
+        using I = std::conditional_t<sizeof(T) == 4, std::int32_t, std::int64_t>;
+        static_assert(sizeof(T) == sizeof(I), "unsupported floating-point type");
+        I i;
+        std::memcpy(&i, &x, sizeof(T));
+        // negative floats are sign-magnitude, flip them so ordering is monotonic
+        return i < 0 ? std::numeric_limits<I>::min() - i : i;
+    }
+}
+
+// Steps between adjacent values from a up to b, 0 <= a <= b, or limit + 1
+// once there are more. Counted one binade at a time, the spacing being
+// constant within each; infinity is one step past the largest finite value.
+template <std::floating_point T>
+static std::uint64_t ulp_count (T a, T b, std::uint64_t limit)
+{
+    using lim = std::numeric_limits<T>;
+    std::uint64_t n = 0;
+    if (std::isinf(b)) {
+        if (std::isinf(a))
+            return 0;
+        n = 1;
+        b = lim::max();
+    }
+    while (a < b) {
+        const bool subnormal = a < lim::min();
+        const T spacing = subnormal ? lim::denorm_min() : std::scalbn(lim::epsilon(), std::ilogb(a));
+        const T top = subnormal ? lim::min() : std::scalbn(T {1}, std::ilogb(a) + 1);
+        const T end = std::min(top, b);
+        const T steps = (end - a) / spacing;    // exact: both ends are multiples of spacing
+        if (steps > static_cast<T>(limit - std::min(n, limit)))
+            return limit + 1;
+        n += static_cast<std::uint64_t>(steps);
+        a = end;
+    }
+    return n;
+}
+
+// Representable values between x and y, or limit + 1 if there are more.
+// Types of 4 or 8 bytes go through the ordinal of their bit pattern; wider
+// ones (long double) have no integer to map onto and are counted instead.
+template <typename T>
+static std::uint64_t ulp_distance (T x, T y, std::uint64_t limit)
+{
+    if constexpr (std::integral<T> || sizeof(T) == 4 || sizeof(T) == 8) {
+        std::int64_t ox = ulp_ordinal(x);
+        std::int64_t oy = ulp_ordinal(y);
+        return ox > oy ? std::uint64_t(ox) - std::uint64_t(oy) : std::uint64_t(oy) - std::uint64_t(ox);
+    } else {
+        const T ax = std::abs(x);
+        const T ay = std::abs(y);
+        if (std::signbit(x) == std::signbit(y))
+            return ulp_count(std::min(ax, ay), std::max(ax, ay), limit);
+        // through zero, where -0.0 and 0.0 are the same point
+        const std::uint64_t nx = ulp_count(T {0}, ax, limit);
+        return nx > limit ? nx : nx + ulp_count(T {0}, ay, limit - nx);
+    }
+}
+
+template <typename T>
+static bool within_tolerance (T x, T y, const tolerance& tol)
+{
+    if (x == y)
+        return true;
+
+    // long double differences are taken in long double, everything else in double
+    using F = std::common_type_t<T, double>;
+    const F dx = static_cast<F>(x);
+    const F dy = static_cast<F>(y);
+    const F diff = std::abs(dx - dy);           // NaN if either is NaN, and every test below fails
+    if (diff <= tol.abs || diff <= tol.rel * std::max(std::abs(dx), std::abs(dy)))
+        return true;
+
+    if (tol.ulps > 0 && !std::isnan(diff))
+        return ulp_distance(x, y, static_cast<std::uint64_t>(tol.ulps)) <= static_cast<std::uint64_t>(tol.ulps);
+    return false;
+}
+
+template <typename T>
+static bool elems_approx_equal (const T* p, const T* q, index_t n, const tolerance& tol)
+{
+    for (index_t i = 0; i < n; i += MATRIX_CMP_BLOCK) {
+        const index_t end = std::min(n, i + MATRIX_CMP_BLOCK);
+        bool ok = true;
+        for (index_t k = i; k < end; ++k)
+            ok &= within_tolerance(p[k], q[k], tol);
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+// Runs cmp(p, q, len) over blocks of [0, n) on all threads; a mismatch found
+// by any thread stops the others at their next block.
+template <typename T, typename Cmp>
+static bool parallel_compare (const T* p, const T* q, index_t n, Cmp cmp)
+{
+    std::atomic<bool> mismatch {false};
+    parallel_for(n, PARALLEL_MIN_GRAIN, [&](int, index_t begin, index_t end) {
+        for (index_t i = begin; i < end; i += PARALLEL_MIN_GRAIN / 8) {
+            if (mismatch.load(std::memory_order_relaxed))
+                return;
+            const index_t len = std::min<index_t>(end - i, PARALLEL_MIN_GRAIN / 8);
+            if (!cmp(p + i, q + i, len)) {
+                mismatch.store(true, std::memory_order_relaxed);
+                return;
+            }
+        }
+    });
+    return !mismatch.load();
+}
+
+// cmp over every element of a and b (of the same shape); padded matrices are
+// compared row by row
+template <typename T, typename Cmp>
+static bool compare_elems (const matrix<T>& a, const matrix<T>& b, exec policy, Cmp cmp)
+{
+    const index_t nc = a.columns();
+    if (a.contiguous() && b.contiguous()) {
+        const index_t n = a.rows() * nc;
+        if (policy == exec::serial)
+            return cmp(a.data(), b.data(), n);
+        return parallel_compare(a.data(), b.data(), n, cmp);
+    }
+
+    std::atomic<bool> mismatch {false};
+    const index_t grain = policy == exec::serial ? std::max(index_t {1}, a.rows()) : parallel_row_grain(nc);
+    parallel_for(a.rows(), grain, [&](int, index_t begin, index_t end) {
+        for (index_t i = begin; i < end; ++i) {
+            if (mismatch.load(std::memory_order_relaxed))
+                return;
+            if (!cmp(a.data() + i * a.stride(), b.data() + i * b.stride(), nc)) {
+                mismatch.store(true, std::memory_order_relaxed);
+                return;
+            }
+        }
+    });
+    return !mismatch.load();
+}
+
+template <typename T>
+bool equal (const matrix<T>& a, const matrix<T>& b, exec policy = exec::serial)
+{
+    if (policy == exec::serial || a.rows() != b.rows() || a.columns() != b.columns())
+        return a == b;
+
+    return compare_elems(a, b, policy, [](const T* p, const T* q, index_t n) {return elems_equal(p, q, n);});
+}
+
+template <typename T>
+bool approx_equal (const matrix<T>& a, const matrix<T>& b, const tolerance& tol = {}, exec policy = exec::serial)
+{
+    if (a.rows() != b.rows() || a.columns() != b.columns())
+        return false;
+
+    return compare_elems(a, b, policy,
+                         [&tol](const T* p, const T* q, index_t n) {return elems_approx_equal(p, q, n, tol);});
+}
+
+// 64-bit fingerprint of shape and contents, see matrix<T>::content_hash()
+template <typename T>
+std::uint64_t fingerprint (const matrix<T>& a)
+{
+    return a.content_hash();
+}
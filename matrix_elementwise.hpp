@@ -0,0 +1,472 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include "matrix.hpp"
+#include "matrix_reduce.hpp"
+#include "parallel.hpp"
+
+// Elementwise operations on matrix<T>, each a single pass over the storage
+// split across threads by rows.
+//
+//      map(a, f)                   -- f(a(i, j)) for every element
+//      map_in_place(a, f)          -- a(i, j) = f(a(i, j))
+//      zip_with(a, b, f)           -- f(a(i, j), b(i, j)), b may be broadcast
+//      add, subtract, hadamard, divide (a, b)
+//      a + s, s + a, a - s, a * s, s * a, a / s and +=, -=, *=, /=
+//      exp, log, tanh, sqrt (a)
+//
+// Fuse whole steps into one lambda, e.g. map(a, [](double x) {return x > 0 ? x : 0.01 * x;}),
+// rather than chaining calls that each make a full pass.
+//
+// Broadcasting: b either has the shape of a, or is a single row (1 x columns),
+// which is applied to every row of a, or a single column (rows x 1), which is
+// applied to every column. The per::row / per::column reductions produce
+// exactly these shapes, so a - mean(a, per::column) is subtract(a, mean(a, per::column)).
+//
+// exp, log and tanh use branch-free polynomial kernels (within a few ULPs of
+// std::exp, std::log, std::tanh) written on SIMD vectors, 2 doubles wide, or
+// 4 when AVX is enabled, so they run vectorized with any build flags, unlike
+// the libm calls. Integral matrices give double results. The kernels compute
+// in double, so long double matrices, and compilers without GCC vector
+// extensions, go through std::exp, std::log and std::tanh instead.
+
+#if defined(__GNUC__)
+#define ELEMENTWISE_VECTOR_KERNELS
+
+/*
+ * Kernels, on vectors of doubles (GCC/Clang vector extensions). Written as
+ * scalar loops they would only be auto-vectorized at -O3 and, on x86-64, with
+ * SSE4.2 or later; as vector code they compile to SIMD instructions at any
+ * optimization level, down to baseline SSE2. Range reduction uses the "add
+ * 1.5 * 2^52" trick instead of conversions between double and 64-bit
+ * integers, which most SIMD instruction sets lack. Special cases are blended
+ * in with bit masks.
+ */
+#define ELEMENTWISE_ROUND_MAGIC     0x1.8p52
+#if defined(__AVX__)
+#define ELEMENTWISE_VECTOR_BYTES    32
+#else
+#define ELEMENTWISE_VECTOR_BYTES    16
+#endif
+
+typedef double vec_d __attribute__((vector_size(ELEMENTWISE_VECTOR_BYTES)));
+typedef std::uint64_t vec_u __attribute__((vector_size(ELEMENTWISE_VECTOR_BYTES)));
+typedef std::int64_t vec_m __attribute__((vector_size(ELEMENTWISE_VECTOR_BYTES)));     // comparison results
+constexpr int vec_lanes = ELEMENTWISE_VECTOR_BYTES / sizeof(double);
+
+static inline vec_u vec_bits (vec_d x) {return std::bit_cast<vec_u>(x);}
+static inline vec_d vec_from_bits (vec_u b) {return std::bit_cast<vec_d>(b);}
+
+// c ? a : b lane by lane, c being a comparison result (all ones or zeros)
+static inline vec_d select_kernel (vec_m c, vec_d a, vec_d b)
+{
+    const vec_u mask = std::bit_cast<vec_u>(c);
+    return vec_from_bits((vec_bits(a) & mask) | (vec_bits(b) & ~mask));
+}
+
+static inline vec_d vec_broadcast (double x)
+{
+    vec_d v;
+    for (int l = 0; l < vec_lanes; ++l)
+        v[l] = x;
+    return v;
+}
+
+// 2^k for integral k in [-1022, 1023], k held in a double
+static inline vec_d pow2_kernel (vec_d k)
+{
+    const vec_u bits = vec_bits(k + ELEMENTWISE_ROUND_MAGIC);
+    return vec_from_bits((bits + 1023) << 52);
+}
+
+// exp(r) - 1 for |r| <= ln(2) / 2, Taylor series to degree 13
+static inline vec_d expm1_poly (vec_d r)
+{
+    vec_d p = vec_broadcast(1.0 / 6227020800);
+    p = p * r + 1.0 / 479001600;
+    p = p * r + 1.0 / 39916800;
+    p = p * r + 1.0 / 3628800;
+    p = p * r + 1.0 / 362880;
+    p = p * r + 1.0 / 40320;
+    p = p * r + 1.0 / 5040;
+    p = p * r + 1.0 / 720;
+    p = p * r + 1.0 / 120;
+    p = p * r + 1.0 / 24;
+    p = p * r + 1.0 / 6;
+    p = p * r + 0.5;
+    p = p * r + 1;
+    return p * r;
+}
+
+// x = k ln(2) + r with |r| <= ln(2) / 2, for x already clamped to a finite range
+static inline vec_d exp_reduce (vec_d x, vec_d& k)
+{
+    constexpr double log2e = 1.44269504088896338700e+00;
+    constexpr double ln2_hi = 6.93147180369123816490e-01;
+    constexpr double ln2_lo = 1.90821492927058770002e-10;
+    k = (x * log2e + ELEMENTWISE_ROUND_MAGIC) - ELEMENTWISE_ROUND_MAGIC;
+    return (x - k * ln2_hi) - k * ln2_lo;
+}
+
+// max(lo, min(x, hi)), with NaN lanes set to 0
+static inline vec_d clamp_kernel (vec_d x, double lo, double hi)
+{
+    x = select_kernel(x < lo, vec_broadcast(lo), x);
+    x = select_kernel(x > hi, vec_broadcast(hi), x);
+    return select_kernel(x != x, vec_broadcast(0), x);
+}
+
+static inline vec_d exp_kernel (vec_d x)
+{
+    // beyond these bounds the result is inf or 0 anyway; NaN is put back at the end
+    vec_d k;
+    const vec_d r = exp_reduce(clamp_kernel(x, -746, 710), k);
+    // 2^k in two factors so that neither overflows and subnormal results round once
+    const vec_d k1 = (k * 0.5 + ELEMENTWISE_ROUND_MAGIC) - ELEMENTWISE_ROUND_MAGIC;
+    const vec_d y = (expm1_poly(r) + 1) * pow2_kernel(k1) * pow2_kernel(k - k1);
+    return select_kernel(x != x, x, y);
+}
+
+// exp(x) - 1 for x <= 0, accurate for small |x| as well
+static inline vec_d expm1_neg_kernel (vec_d x)
+{
+    vec_d k;
+    const vec_d r = exp_reduce(clamp_kernel(x, -64, 0), k);
+    const vec_d s = pow2_kernel(k);
+    const vec_d y = s * expm1_poly(r) + (s - 1);
+    return select_kernel(x != x, x, y);
+}
+
+static inline vec_d tanh_kernel (vec_d x)
+{
+    constexpr std::uint64_t sign = 0x8000000000000000ULL;
+    // tanh |x| = -e / (2 + e) with e = exp(-2 |x|) - 1 in (-1, 0]: no overflow,
+    // and no cancellation for small |x|
+    const vec_d ax = vec_from_bits(vec_bits(x) & ~sign);
+    const vec_d e = expm1_neg_kernel(-2 * ax);
+    const vec_d t = -e / (2 + e);
+    return vec_from_bits((vec_bits(t) & ~sign) | (vec_bits(x) & sign));
+}
+
+static inline vec_d log_kernel (vec_d x)
+{
+    constexpr double ln2_hi = 6.93147180369123816490e-01;
+    constexpr double ln2_lo = 1.90821492927058770002e-10;
+    constexpr double sqrt2 = 1.41421356237309504880;
+
+    // x = m * 2^e with m in [sqrt(1/2), sqrt(2)); subnormals are scaled up first
+    const vec_m tiny = x < std::numeric_limits<double>::min();
+    const vec_u bits = vec_bits(select_kernel(tiny, x * 0x1p54, x));
+    const vec_d bias = select_kernel(tiny, vec_broadcast(1023 + 54), vec_broadcast(1023));
+    const vec_d e0 = vec_from_bits(0x4330000000000000ULL | (bits >> 52 & 0x7ff)) - 0x1p52 - bias;
+    const vec_d m0 = vec_from_bits((bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL);
+    const vec_m high = m0 > sqrt2;
+    const vec_d m = select_kernel(high, m0 * 0.5, m0);
+    const vec_d e = select_kernel(high, e0 + 1, e0);
+
+    // log(m) = 2 atanh(s) = 2 (s + s^3/3 + s^5/5 + ...), |s| <= 0.172
+    const vec_d s = (m - 1) / (m + 1);
+    const vec_d s2 = s * s;
+    vec_d p = vec_broadcast(1.0 / 21);
+    p = p * s2 + 1.0 / 19;
+    p = p * s2 + 1.0 / 17;
+    p = p * s2 + 1.0 / 15;
+    p = p * s2 + 1.0 / 13;
+    p = p * s2 + 1.0 / 11;
+    p = p * s2 + 1.0 / 9;
+    p = p * s2 + 1.0 / 7;
+    p = p * s2 + 1.0 / 5;
+    p = p * s2 + 1.0 / 3;
+    const vec_d y = e * ln2_hi + (2 * s + (2 * s * s2 * p + e * ln2_lo));
+
+    constexpr double inf = std::numeric_limits<double>::infinity();
+    const vec_d special = select_kernel(x == 0, vec_broadcast(-inf), vec_broadcast(std::numeric_limits<double>::quiet_NaN()));
+    return select_kernel(x > 0, select_kernel(x == inf, vec_broadcast(inf), y), special);
+}
+#endif
+
+
+/*
+ * Drivers: rows are split across threads with parallel_row_grain, the split
+ * every row-parallel kernel and matrix<T>'s first-touch constructor use.
+ * Results are allocated uninitialized, so their pages are first written by
+ * the thread that computes them.
+ */
+
+// r(i, j) = f(a(i, j))
+template <typename R, typename T, typename F>
+static void map_rows (R* r, index_t ldr, const T* a, index_t lda, index_t nr, index_t nc, F& f)
+{
+    parallel_for(nr, parallel_row_grain(nc), [&](int, index_t begin, index_t end) {
+        if (ldr == nc && lda == nc) {
+            // packed rows: one run over the whole chunk
+            R* p = r + begin * nc;
+            const T* q = a + begin * nc;
+            const index_t n = (end - begin) * nc;
+            for (index_t k = 0; k < n; ++k)
+                p[k] = f(q[k]);
+            return;
+        }
+        for (index_t i = begin; i < end; ++i) {
+            R* p = r + i * ldr;
+            const T* q = a + i * lda;
+            for (index_t j = 0; j < nc; ++j)
+                p[j] = f(q[j]);
+        }
+    });
+}
+
+template <typename T, typename F>
+auto map (const matrix<T>& a, F f)
+{
+    using R = std::remove_cvref_t<std::invoke_result_t<F&, T>>;
+    matrix<R> mr {a.rows(), a.columns(), uninitialized};
+    map_rows(mr.data(), mr.stride(), a.data(), a.stride(), a.rows(), a.columns(), f);
+    return mr;
+}
+
+#if defined(ELEMENTWISE_VECTOR_KERNELS)
+// r[k] = kernel(a[k]) for 0 <= k < n, vec_lanes at a time; the last, partial
+// vector is padded with 1 (a valid argument for every kernel)
+template <typename R, typename T, typename K>
+static void map_lanes (R* r, const T* a, index_t n, K kernel)
+{
+    index_t k = 0;
+    for (; k + vec_lanes <= n; k += vec_lanes) {
+        vec_d x;
+        for (int l = 0; l < vec_lanes; ++l)
+            x[l] = static_cast<double>(a[k + l]);
+        const vec_d y = kernel(x);
+        for (int l = 0; l < vec_lanes; ++l)
+            r[k + l] = static_cast<R>(y[l]);
+    }
+    if (k < n) {
+        vec_d x = vec_broadcast(1);
+        for (int l = 0; l < n - k; ++l)
+            x[l] = static_cast<double>(a[k + l]);
+        const vec_d y = kernel(x);
+        for (int l = 0; l < n - k; ++l)
+            r[k + l] = static_cast<R>(y[l]);
+    }
+}
+
+// map_rows for the vector kernels
+template <typename R, typename T, typename K>
+static void map_rows_lanes (R* r, index_t ldr, const T* a, index_t lda, index_t nr, index_t nc, K kernel)
+{
+    parallel_for(nr, parallel_row_grain(nc), [&](int, index_t begin, index_t end) {
+        if (ldr == nc && lda == nc) {
+            map_lanes(r + begin * nc, a + begin * nc, (end - begin) * nc, kernel);
+            return;
+        }
+        for (index_t i = begin; i < end; ++i)
+            map_lanes(r + i * ldr, a + i * lda, nc, kernel);
+    });
+}
+
+template <typename T, typename K>
+static matrix<real_t<T>> map_kernel (const matrix<T>& a, K kernel)
+{
+    matrix<real_t<T>> mr {a.rows(), a.columns(), uninitialized};
+    map_rows_lanes(mr.data(), mr.stride(), a.data(), a.stride(), a.rows(), a.columns(), kernel);
+    return mr;
+}
+#endif
+
+// the padding of a is not touched, so it stays T {}
+template <typename T, typename F>
+matrix<T>& map_in_place (matrix<T>& a, F f)
+{
+    T* p = a.data();
+    map_rows(p, a.stride(), static_cast<const T*>(p), a.stride(), a.rows(), a.columns(), f);
+    return a;
+}
+
+template <typename T, typename U>
+static void check_broadcast (const matrix<T>& a, const matrix<U>& b)
+{
+    const bool same = b.rows() == a.rows() && b.columns() == a.columns();
+    const bool row = b.rows() == 1 && b.columns() == a.columns();
+    const bool clm = b.rows() == a.rows() && b.columns() == 1;
+    if (!same && !row && !clm)
+        throw std::invalid_argument ("shapes cannot be broadcast");
+}
+
+template <typename T, typename U, typename F>
+auto zip_with (const matrix<T>& a, const matrix<U>& b, F f)
+{
+    using R = std::remove_cvref_t<std::invoke_result_t<F&, T, U>>;
+    check_broadcast(a, b);
+
+    const index_t nr = a.rows();
+    const index_t nc = a.columns();
+    // a single column is broadcast when b has one column but a does not (a
+    // single row needs no special case: its stride is simply 0)
+    const bool clm = b.columns() == 1 && nc != 1;
+    const index_t ldb = b.rows() == 1 && nr != 1 ? 0 : b.stride();
+
+    matrix<R> mr {nr, nc, uninitialized};
+    R* r = mr.data();
+    const T* pa = a.data();
+    const U* pb = b.data();
+    parallel_for(nr, parallel_row_grain(nc), [&](int, index_t begin, index_t end) {
+        for (index_t i = begin; i < end; ++i) {
+            R* p = r + i * mr.stride();
+            const T* q = pa + i * a.stride();
+            if (clm) {
+                const U y = pb[i * ldb];
+                for (index_t j = 0; j < nc; ++j)
+                    p[j] = f(q[j], y);
+            } else {
+                const U* s = pb + i * ldb;
+                for (index_t j = 0; j < nc; ++j)
+                    p[j] = f(q[j], s[j]);
+            }
+        }
+    });
+    return mr;
+}
+
+template <typename T>
+matrix<T> add (const matrix<T>& a, const matrix<T>& b)
+{
+    return zip_with(a, b, [](T x, T y) -> T {return x + y;});
+}
+
+template <typename T>
+matrix<T> subtract (const matrix<T>& a, const matrix<T>& b)
+{
+    return zip_with(a, b, [](T x, T y) -> T {return x - y;});
+}
+
+// elementwise product
+template <typename T>
+matrix<T> hadamard (const matrix<T>& a, const matrix<T>& b)
+{
+    return zip_with(a, b, [](T x, T y) -> T {return x * y;});
+}
+
+template <typename T>
+matrix<T> divide (const matrix<T>& a, const matrix<T>& b)
+{
+    return zip_with(a, b, [](T x, T y) -> T {return x / y;});
+}
+
+
+/*
+ * Scalars. The scalar is taken as T, so m * 2 works for matrix<double>.
+ */
+template <typename T>
+matrix<T> operator +(const matrix<T>& a, std::type_identity_t<T> s)
+{
+    return map(a, [s](T x) -> T {return x + s;});
+}
+
+template <typename T>
+matrix<T> operator +(std::type_identity_t<T> s, const matrix<T>& a)
+{
+    return a + s;
+}
+
+template <typename T>
+matrix<T> operator -(const matrix<T>& a, std::type_identity_t<T> s)
+{
+    return map(a, [s](T x) -> T {return x - s;});
+}
+
+template <typename T>
+matrix<T> operator *(const matrix<T>& a, std::type_identity_t<T> s)
+{
+    return map(a, [s](T x) -> T {return x * s;});
+}
+
+template <typename T>
+matrix<T> operator *(std::type_identity_t<T> s, const matrix<T>& a)
+{
+    return a * s;
+}
+
+template <typename T>
+matrix<T> operator /(const matrix<T>& a, std::type_identity_t<T> s)
+{
+    return map(a, [s](T x) -> T {return x / s;});
+}
+
+template <typename T>
+matrix<T>& operator +=(matrix<T>& a, std::type_identity_t<T> s)
+{
+    return map_in_place(a, [s](T x) -> T {return x + s;});
+}
+
+template <typename T>
+matrix<T>& operator -=(matrix<T>& a, std::type_identity_t<T> s)
+{
+    return map_in_place(a, [s](T x) -> T {return x - s;});
+}
+
+template <typename T>
+matrix<T>& operator *=(matrix<T>& a, std::type_identity_t<T> s)
+{
+    return map_in_place(a, [s](T x) -> T {return x * s;});
+}
+
+template <typename T>
+matrix<T>& operator /=(matrix<T>& a, std::type_identity_t<T> s)
+{
+    return map_in_place(a, [s](T x) -> T {return x / s;});
+}
+
+
+/*
+ * Transcendental functions
+ */
+
+// element types the double kernels are accurate for
+template <typename T>
+concept vector_kernel_type = !std::same_as<real_t<T>, long double>;
+
+template <typename T>
+matrix<real_t<T>> exp (const matrix<T>& a)
+{
+#if defined(ELEMENTWISE_VECTOR_KERNELS)
+    if constexpr (vector_kernel_type<T>)
+        return map_kernel(a, [](vec_d x) {return exp_kernel(x);});
+#endif
+    return map(a, [](T x) {return std::exp(static_cast<real_t<T>>(x));});
+}
+
+template <typename T>
+matrix<real_t<T>> log (const matrix<T>& a)
+{
+#if defined(ELEMENTWISE_VECTOR_KERNELS)
+    if constexpr (vector_kernel_type<T>)
+        return map_kernel(a, [](vec_d x) {return log_kernel(x);});
+#endif
+    return map(a, [](T x) {return std::log(static_cast<real_t<T>>(x));});
+}
+
+template <typename T>
+matrix<real_t<T>> tanh (const matrix<T>& a)
+{
+#if defined(ELEMENTWISE_VECTOR_KERNELS)
+    if constexpr (vector_kernel_type<T>)
+        return map_kernel(a, [](vec_d x) {return tanh_kernel(x);});
+#endif
+    return map(a, [](T x) {return std::tanh(static_cast<real_t<T>>(x));});
+}
+
+// IEEE square root is exact, so this one is std::sqrt (vectorized by the
+// compiler when errno is not needed, e.g. -fno-math-errno)
+template <typename T>
+matrix<real_t<T>> sqrt (const matrix<T>& a)
+{
+    using R = real_t<T>;
+    return map(a, [](T x) {return std::sqrt(static_cast<R>(x));});
+}
@@ -0,0 +1,623 @@
+#pragma once
+#include <cmath>
+#include <concepts>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "matrix.hpp"
+#include "parallel.hpp"
+
+// Reductions over all elements, per row or per column of a matrix<T>, and over
+// all elements of a Vector<T>.
+//
+//      sum, product, min, max, argmin, argmax, mean, variance, frobenius_norm
+//
+// The scalar forms reduce everything. Passing per::row gives one result per
+// row (a rows() x 1 matrix), per::column one result per column (a 1 x columns()
+// matrix). argmin/argmax return 1-based positions.
+//
+// Floating-point sums use pairwise summation over contiguous data and Kahan
+// summation for column sums, so accuracy does not degrade with the length of
+// the reduced dimension. mean, variance and frobenius_norm of integral
+// matrices are computed in double.
+//
+// sum of an integral matrix/vector accumulates in 64 bits and is converted to
+// T at the end: the result is exact whenever the total fits in T, and wraps
+// modulo 2^bits(T) otherwise. Use mean, or convert to a wider T first, for
+// totals that do not fit. product is computed in T.
+
+enum class per { row, column };
+
+template <typename T>
+using real_t = std::conditional_t<std::floating_point<T>, T, double>;
+
+// accumulator of sum: T itself for floating point, 64 bits for integers
+template <typename T>
+using sum_t = std::conditional_t<std::floating_point<T>, T,
+              std::conditional_t<std::is_signed_v<T>, long long, unsigned long long>>;
+
+#define REDUCE_PAIRWISE_BLOCK   128     // leaf size of the pairwise summation
+
+// sum of f(p[i]) for 0 <= i < n; the leaves use 8 independent accumulators so
+// the loop vectorizes
+template <typename R, typename T, typename F>
+static R pairwise_sum (const T* p, index_t n, F f)
+{
+    if (n <= REDUCE_PAIRWISE_BLOCK) {
+        // leaves are short, so they count with int
+        const int m = static_cast<int>(n);
+        R acc[8] = {};
+        int i = 0;
+        for (; i + 8 <= m; i += 8) {
+            for (int k = 0; k < 8; ++k)
+                acc[k] += f(p[i + k]);
+        }
+        for (; i < m; ++i)
+            acc[0] += f(p[i]);
+        return ((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+    }
+    index_t half = (n / 2) & ~7;
+    return pairwise_sum<R>(p, half, f) + pairwise_sum<R>(p + half, n - half, f);
+}
+
+// pairwise_sum split across threads
+template <typename R, typename T, typename F>
+static R parallel_sum (const T* p, index_t n, F f)
+{
+    std::vector<R> partial(parallel_chunks(n, PARALLEL_MIN_GRAIN));
+    parallel_for(n, PARALLEL_MIN_GRAIN, [&](int c, index_t begin, index_t end) {
+        partial[c] = pairwise_sum<R>(p + begin, end - begin, f);
+    });
+
+    R total {};
+    for (auto& s : partial)
+        total += s;
+    return total;
+}
+
+template <typename T>
+static T reduce_product (const T* p, index_t n)
+{
+    T acc[4] = {1, 1, 1, 1};
+    index_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (index_t k = 0; k < 4; ++k)
+            acc[k] *= p[i + k];
+    }
+    for (; i < n; ++i)
+        acc[0] *= p[i];
+    return (acc[0] * acc[1]) * (acc[2] * acc[3]);
+}
+
+// 0-based index of the first minimum (or maximum, when Max is true)
+template <bool Max, typename T>
+static index_t reduce_argbest (const T* p, index_t n)
+{
+    index_t best = 0;
+    for (index_t i = 1; i < n; ++i) {
+        if (Max ? p[i] > p[best] : p[i] < p[best])
+            best = i;
+    }
+    return best;
+}
+
+template <bool Max, typename T>
+static index_t parallel_argbest (const T* p, index_t n)
+{
+    std::vector<index_t> partial(parallel_chunks(n, PARALLEL_MIN_GRAIN));
+    parallel_for(n, PARALLEL_MIN_GRAIN, [&](int c, index_t begin, index_t end) {
+        partial[c] = begin + reduce_argbest<Max>(p + begin, end - begin);
+    });
+
+    // chunks are in index order, so ties keep the first occurrence
+    index_t best = partial[0];
+    for (index_t i : partial) {
+        if (Max ? p[i] > p[best] : p[i] < p[best])
+            best = i;
+    }
+    return best;
+}
+
+static inline void check_nonempty (index_t n)
+{
+    if (n == 0)
+        throw std::invalid_argument ("reduction of an empty matrix/vector");
+}
+
+template <typename T>
+static real_t<T> reduce_mean (const T* p, index_t n)
+{
+    check_nonempty(n);
+    return parallel_sum<real_t<T>>(p, n, [](T x) {return static_cast<real_t<T>>(x);}) / n;
+}
+
+// two-pass variance: mean first, then the squared deviations from it
+template <typename T>
+static real_t<T> reduce_variance (const T* p, index_t n, int ddof)
+{
+    using R = real_t<T>;
+    if (n - ddof <= 0)
+        throw std::invalid_argument ("not enough elements for the requested degrees of freedom");
+
+    const R mu = reduce_mean(p, n);
+    R ss = parallel_sum<R>(p, n, [mu](T x) {R d = static_cast<R>(x) - mu; return d * d;});
+    return ss / (n - ddof);
+}
+
+/*
+ * Per-row reductions: rows are contiguous, so each row uses the scalar kernel.
+ * Rows are spread across threads.
+ */
+template <typename R, typename T, typename F>
+static matrix<R> reduce_rows (const matrix<T>& a, F f)
+{
+    const index_t nr = a.rows();
+    const index_t nc = a.columns();
+    const index_t ld = a.stride();
+    matrix<R> mr {nr, nr == 0 ? 0 : 1};
+    R* pr = mr.data();
+    const T* pa = a.data();
+    parallel_for(nr, parallel_row_grain(nc), [&](int, index_t begin, index_t end) {
+        for (index_t i = begin; i < end; ++i)
+            pr[i] = f(pa + i * ld, nc);
+    });
+    return mr;
+}
+
+// sum of f over all elements: one pass over the storage when the rows are
+// packed, per-row sums added pairwise when they are padded
+template <typename R, typename T, typename F>
+static R sum_elems (const matrix<T>& a, F f)
+{
+    if (a.contiguous())
+        return parallel_sum<R>(a.data(), a.rows() * a.columns(), f);
+
+    auto rs = reduce_rows<R>(a, [&f](const T* p, index_t n) {return pairwise_sum<R>(p, n, f);});
+    return pairwise_sum<R>(rs.data(), rs.rows(), [](R x) {return x;});
+}
+
+// 0-based (row, clm) of the first minimum / maximum in row-major order
+template <bool Max, typename T>
+static std::pair<index_t, index_t> argbest_elems (const matrix<T>& a)
+{
+    check_nonempty(a.rows());
+    const index_t nc = a.columns();
+    if (a.contiguous()) {
+        index_t i = parallel_argbest<Max>(a.data(), a.rows() * nc);
+        return {i / nc, i % nc};
+    }
+
+    auto best = reduce_rows<index_t>(a, [](const T* p, index_t n) {return reduce_argbest<Max>(p, n);});
+    const index_t* pb = best.data();
+    const T* pa = a.data();
+    const index_t ld = a.stride();
+    index_t bi = 0;
+    for (index_t i = 1; i < a.rows(); ++i) {
+        T x = pa[i * ld + pb[i]];
+        T y = pa[bi * ld + pb[bi]];
+        if (Max ? x > y : x < y)
+            bi = i;
+    }
+    return {bi, pb[bi]};
+}
+
+/*
+ * Per-column reductions sweep the matrix row by row and update one
+ * accumulator per column, so memory is read sequentially. When there are
+ * enough columns to go around, threads take contiguous blocks of columns and
+ * each sweeps every row. Tall, narrow matrices are split into blocks of rows
+ * instead (the row-parallel split); each block keeps its own accumulators,
+ * which are then merged in row order.
+ *
+ * For element x = a(i, j) (0-based), first(s, j, x, i) starts column j's
+ * state s at the first row of a block and step(s, j, x, i) folds in the
+ * following rows. merge(s, t) folds the state t of a later block into s.
+ */
+template <typename S, typename T, typename First, typename Step, typename Merge>
+static std::vector<S> sweep_columns (const matrix<T>& a, First first, Step step, Merge merge)
+{
+    const index_t nr = a.rows();
+    const index_t nc = a.columns();
+    const index_t ld = a.stride();
+    const T* pa = a.data();
+    std::vector<S> state(nc);
+    if (nr == 0)
+        return state;
+
+    auto sweep = [&](S* st, index_t r0, index_t r1, index_t j0, index_t j1) {
+        const T* row = pa + r0 * ld;
+        for (index_t j = j0; j < j1; ++j)
+            first(st[j], j, row[j], r0);
+        for (index_t i = r0 + 1; i < r1; ++i) {
+            row = pa + i * ld;
+            for (index_t j = j0; j < j1; ++j)
+                step(st[j], j, row[j], i);
+        }
+    };
+
+    const index_t clm_grain = std::max(index_t {16}, PARALLEL_MIN_GRAIN / nr);
+    const index_t row_grain = parallel_row_grain(nc);
+    const int row_chunks = parallel_chunks(nr, row_grain);
+    if (parallel_chunks(nc, clm_grain) >= row_chunks) {
+        parallel_for(nc, clm_grain, [&](int, index_t begin, index_t end) {
+            sweep(state.data(), 0, nr, begin, end);
+        });
+        return state;
+    }
+
+    std::vector<std::vector<S>> partial(row_chunks - 1, std::vector<S>(nc));
+    parallel_for(nr, row_grain, [&](int c, index_t begin, index_t end) {
+        sweep(c == 0 ? state.data() : partial[c - 1].data(), begin, end, 0, nc);
+    });
+    for (const std::vector<S>& t : partial) {
+        for (index_t j = 0; j < nc; ++j)
+            merge(state[j], t[j]);
+    }
+    return state;
+}
+
+// Kahan-compensated running sum: the total is s - c
+template <typename R>
+struct kahan_sum {
+    R s;
+    R c;
+
+    void add (R x)
+    {
+        R y = x - c;
+        R t = s + y;
+        c = (t - s) - y;
+        s = t;
+    }
+};
+
+// column sums of f(a(i, j)); Kahan-compensated for floating-point R
+template <typename R, typename T, typename F>
+static matrix<R> sum_columns (const matrix<T>& a, F f)
+{
+    const index_t nc = a.columns();
+    matrix<R> mr {nc == 0 ? 0 : 1, nc};
+    R* s = mr.data();
+
+    if constexpr (std::floating_point<R>) {
+        auto st = sweep_columns<kahan_sum<R>>(a,
+            [&](kahan_sum<R>& k, index_t, T x, index_t) {k = {f(x), R {}};},
+            [&](kahan_sum<R>& k, index_t, T x, index_t) {k.add(f(x));},
+            [](kahan_sum<R>& k, const kahan_sum<R>& t) {k.add(t.s - t.c);});
+        for (index_t j = 0; j < nc; ++j)
+            s[j] = st[j].s;
+    } else {
+        using A = sum_t<R>;
+        auto st = sweep_columns<A>(a,
+            [&](A& acc, index_t, T x, index_t) {acc = static_cast<A>(f(x));},
+            [&](A& acc, index_t, T x, index_t) {acc += static_cast<A>(f(x));},
+            [](A& acc, A t) {acc += t;});
+        for (index_t j = 0; j < nc; ++j)
+            s[j] = static_cast<R>(st[j]);
+    }
+    return mr;
+}
+
+template <bool Max, typename T>
+static Vector<index_t> argbest_columns (const matrix<T>& a)
+{
+    const index_t nc = a.columns();
+    check_nonempty(a.rows());
+
+    // a later block only wins with a strictly better value, so ties keep the
+    // first occurrence
+    struct best { T x; index_t i; };
+    auto st = sweep_columns<best>(a,
+        [](best& b, index_t, T x, index_t i) {b = {x, i};},
+        [](best& b, index_t, T x, index_t i) {if (Max ? x > b.x : x < b.x) b = {x, i};},
+        [](best& b, const best& t) {if (Max ? t.x > b.x : t.x < b.x) b = t;});
+
+    Vector<index_t> idx;
+    idx.resize(nc);
+    for (index_t j = 0; j < nc; ++j)
+        idx[j] = st[j].i + 1;
+    return idx;
+}
+
+
+/*
+ * All elements
+ */
+template <typename T>
+T sum (const matrix<T>& a)
+{
+    return static_cast<T>(sum_elems<sum_t<T>>(a, [](T x) {return static_cast<sum_t<T>>(x);}));
+}
+
+template <typename T>
+T product (const matrix<T>& a)
+{
+    if (a.contiguous())
+        return reduce_product(a.data(), a.rows() * a.columns());
+
+    auto rp = reduce_rows<T>(a, [](const T* p, index_t n) {return reduce_product(p, n);});
+    return reduce_product(rp.data(), rp.rows());
+}
+
+// (row, clm) of the first minimum / maximum in row-major order
+template <typename T>
+std::pair<index_t, index_t> argmin (const matrix<T>& a)
+{
+    auto [i, j] = argbest_elems<false>(a);
+    return {i + 1, j + 1};
+}
+
+template <typename T>
+std::pair<index_t, index_t> argmax (const matrix<T>& a)
+{
+    auto [i, j] = argbest_elems<true>(a);
+    return {i + 1, j + 1};
+}
+
+template <typename T>
+T min (const matrix<T>& a)
+{
+    auto [i, j] = argmin(a);
+    return a(i, j);
+}
+
+template <typename T>
+T max (const matrix<T>& a)
+{
+    auto [i, j] = argmax(a);
+    return a(i, j);
+}
+
+template <typename T>
+real_t<T> mean (const matrix<T>& a)
+{
+    using R = real_t<T>;
+    const index_t n = a.rows() * a.columns();
+    check_nonempty(n);
+    return sum_elems<R>(a, [](T x) {return static_cast<R>(x);}) / n;
+}
+
+// ddof = 0 gives the population variance, ddof = 1 the sample variance
+template <typename T>
+real_t<T> variance (const matrix<T>& a, int ddof = 0)
+{
+    using R = real_t<T>;
+    const index_t n = a.rows() * a.columns();
+    if (n - ddof <= 0)
+        throw std::invalid_argument ("not enough elements for the requested degrees of freedom");
+
+    const R mu = mean(a);
+    return sum_elems<R>(a, [mu](T x) {R d = static_cast<R>(x) - mu; return d * d;}) / (n - ddof);
+}
+
+template <typename T>
+real_t<T> frobenius_norm (const matrix<T>& a)
+{
+    using R = real_t<T>;
+    return std::sqrt(sum_elems<R>(a, [](T x) {R y = static_cast<R>(x); return y * y;}));
+}
+
+
+/*
+ * Per row / per column
+ */
+template <typename T>
+matrix<T> sum (const matrix<T>& a, per dim)
+{
+    using A = sum_t<T>;
+    auto id = [](T x) {return x;};
+    if (dim == per::row) {
+        return reduce_rows<T>(a, [](const T* p, index_t n) {
+            return static_cast<T>(pairwise_sum<A>(p, n, [](T x) {return static_cast<A>(x);}));
+        });
+    }
+    return sum_columns<T>(a, id);
+}
+
+template <typename T>
+matrix<T> product (const matrix<T>& a, per dim)
+{
+    if (dim == per::row)
+        return reduce_rows<T>(a, [](const T* p, index_t n) {return reduce_product(p, n);});
+
+    matrix<T> mr {a.columns() == 0 ? 0 : 1, a.columns()};
+    T* pr = mr.data();
+    if (a.rows() == 0) {
+        std::fill(pr, pr + a.columns(), T {1});
+        return mr;
+    }
+    auto st = sweep_columns<T>(a,
+        [](T& p, index_t, T x, index_t) {p = x;},
+        [](T& p, index_t, T x, index_t) {p *= x;},
+        [](T& p, T t) {p *= t;});
+    std::copy(st.begin(), st.end(), pr);
+    return mr;
+}
+
+// 1-based column of each row's minimum, or row of each column's minimum
+template <typename T>
+Vector<index_t> argmin (const matrix<T>& a, per dim)
+{
+    if (dim == per::column)
+        return argbest_columns<false>(a);
+
+    check_nonempty(a.columns());
+    auto mr = reduce_rows<index_t>(a, [](const T* p, index_t n) {return reduce_argbest<false>(p, n) + 1;});
+    Vector<index_t> idx;
+    idx.resize(a.rows());
+    std::copy(mr.data(), mr.data() + a.rows(), idx.data());
+    return idx;
+}
+
+template <typename T>
+Vector<index_t> argmax (const matrix<T>& a, per dim)
+{
+    if (dim == per::column)
+        return argbest_columns<true>(a);
+
+    check_nonempty(a.columns());
+    auto mr = reduce_rows<index_t>(a, [](const T* p, index_t n) {return reduce_argbest<true>(p, n) + 1;});
+    Vector<index_t> idx;
+    idx.resize(a.rows());
+    std::copy(mr.data(), mr.data() + a.rows(), idx.data());
+    return idx;
+}
+
+template <typename T>
+matrix<T> min (const matrix<T>& a, per dim)
+{
+    if (dim == per::row) {
+        check_nonempty(a.columns());
+        return reduce_rows<T>(a, [](const T* p, index_t n) {return p[reduce_argbest<false>(p, n)];});
+    }
+
+    check_nonempty(a.rows());
+    matrix<T> mr {1, a.columns()};
+    auto st = sweep_columns<T>(a,
+        [](T& m, index_t, T x, index_t) {m = x;},
+        [](T& m, index_t, T x, index_t) {m = x < m ? x : m;},
+        [](T& m, T t) {m = t < m ? t : m;});
+    std::copy(st.begin(), st.end(), mr.data());
+    return mr;
+}
+
+template <typename T>
+matrix<T> max (const matrix<T>& a, per dim)
+{
+    if (dim == per::row) {
+        check_nonempty(a.columns());
+        return reduce_rows<T>(a, [](const T* p, index_t n) {return p[reduce_argbest<true>(p, n)];});
+    }
+
+    check_nonempty(a.rows());
+    matrix<T> mr {1, a.columns()};
+    auto st = sweep_columns<T>(a,
+        [](T& m, index_t, T x, index_t) {m = x;},
+        [](T& m, index_t, T x, index_t) {m = x > m ? x : m;},
+        [](T& m, T t) {m = t > m ? t : m;});
+    std::copy(st.begin(), st.end(), mr.data());
+    return mr;
+}
+
+template <typename T>
+matrix<real_t<T>> mean (const matrix<T>& a, per dim)
+{
+    using R = real_t<T>;
+    if (dim == per::row) {
+        check_nonempty(a.columns());
+        return reduce_rows<R>(a, [](const T* p, index_t n) {
+            return pairwise_sum<R>(p, n, [](T x) {return static_cast<R>(x);}) / n;
+        });
+    }
+
+    check_nonempty(a.rows());
+    auto mr = sum_columns<R>(a, [](T x) {return static_cast<R>(x);});
+    for (index_t j = 0; j < a.columns(); ++j)
+        mr.data()[j] /= a.rows();
+    return mr;
+}
+
+template <typename T>
+matrix<real_t<T>> variance (const matrix<T>& a, per dim, int ddof = 0)
+{
+    using R = real_t<T>;
+    if (dim == per::row) {
+        if (a.columns() - ddof <= 0)
+            throw std::invalid_argument ("not enough elements for the requested degrees of freedom");
+        return reduce_rows<R>(a, [ddof](const T* p, index_t n) {
+            const R mu = pairwise_sum<R>(p, n, [](T x) {return static_cast<R>(x);}) / n;
+            return pairwise_sum<R>(p, n, [mu](T x) {R d = static_cast<R>(x) - mu; return d * d;}) / (n - ddof);
+        });
+    }
+
+    if (a.rows() - ddof <= 0)
+        throw std::invalid_argument ("not enough elements for the requested degrees of freedom");
+    auto mu = mean(a, per::column);
+    const R* pm = mu.data();
+
+    // second sweep over the squared deviations, Kahan-compensated like sum_columns
+    const index_t nc = a.columns();
+    matrix<R> mr {1, nc};
+    R* s = mr.data();
+    auto sq = [pm](index_t j, T x) {R d = static_cast<R>(x) - pm[j]; return d * d;};
+    auto st = sweep_columns<kahan_sum<R>>(a,
+        [&](kahan_sum<R>& k, index_t j, T x, index_t) {k = {sq(j, x), R {}};},
+        [&](kahan_sum<R>& k, index_t j, T x, index_t) {k.add(sq(j, x));},
+        [](kahan_sum<R>& k, const kahan_sum<R>& t) {k.add(t.s - t.c);});
+    for (index_t j = 0; j < nc; ++j)
+        s[j] = st[j].s / (a.rows() - ddof);
+    return mr;
+}
+
+
+/*
+ * Vector<T>
+ */
+template <typename T>
+requires std::integral<T> || std::floating_point<T>
+T sum (const Vector<T>& v)
+{
+    return static_cast<T>(parallel_sum<sum_t<T>>(v.data(), v.size(), [](T x) {return static_cast<sum_t<T>>(x);}));
+}
+
+template <typename T>
+requires std::integral<T> || std::floating_point<T>
+T product (const Vector<T>& v)
+{
+    return reduce_product(v.data(), v.size());
+}
+
+// 0-based, like Vector<T>::operator[]
+template <typename T>
+requires std::integral<T> || std::floating_point<T>
+index_t argmin (const Vector<T>& v)
+{
+    check_nonempty(v.size());
+    return parallel_argbest<false>(v.data(), v.size());
+}
+
+template <typename T>
+requires std::integral<T> || std::floating_point<T>
+index_t argmax (const Vector<T>& v)
+{
+    check_nonempty(v.size());
+    return parallel_argbest<true>(v.data(), v.size());
+}
+
+template <typename T>
+requires std::integral<T> || std::floating_point<T>
+T min (const Vector<T>& v)
+{
+    return v[argmin(v)];
+}
+
+template <typename T>
+requires std::integral<T> || std::floating_point<T>
+T max (const Vector<T>& v)
+{
+    return v[argmax(v)];
+}
+
+template <typename T>
+requires std::integral<T> || std::floating_point<T>
+real_t<T> mean (const Vector<T>& v)
+{
+    return reduce_mean(v.data(), v.size());
+}
+
+template <typename T>
+requires std::integral<T> || std::floating_point<T>
+real_t<T> variance (const Vector<T>& v, int ddof = 0)
+{
+    return reduce_variance(v.data(), v.size(), ddof);
+}
+
+// Euclidean norm
+template <typename T>
+requires std::integral<T> || std::floating_point<T>
+real_t<T> norm (const Vector<T>& v)
+{
+    using R = real_t<T>;
+    return std::sqrt(parallel_sum<R>(v.data(), v.size(), [](T x) {R y = static_cast<R>(x); return y * y;}));
+}
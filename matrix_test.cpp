@@ -1,6 +1,16 @@
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <utility>
 #include "matrix.hpp"
+#include "structured_matrix.hpp"
+#include "matrix_reduce.hpp"
+#include "matrix_compare.hpp"
+#include "matrix_cache.hpp"
+#include "matrix_elementwise.hpp"
+#include "matrix_chain.hpp"
 
 #define NROWS1  3
 #define NCLMS1  4
@@ -68,8 +78,15 @@ constexpr int as1[NROWS_S1][NCLMS_S1] = {
                                             {12, 19, 20}
                                         };
 
-template<typename T>
-bool check_eq (T val1, T val2)
+// Symmetric square matrix
+constexpr int asym[NROWS_S1][NCLMS_S1] ={
+                                            {4, 1, 2},
+                                            {1, 5, 3},
+                                            {2, 3, 6}
+                                        };
+
+template<typename T, typename U>
+bool check_eq (T val1, U val2)
 {
     if (val1 == val2)
         return true;
@@ -325,6 +342,831 @@ void test_product()
     std::cout << "End test: Product PASS" << std::endl;
 }
 
+void test_shape_overflow()
+{
+    std::cout << "Start test: Shape overflow" << std::endl;
+    // products of non-integral values are not truncated
+    matrix<double> h {1, 2};
+    h(1, 1) = 0.5;
+    h(1, 2) = 0.25;
+    auto hh = h * h.transpose();
+    CHECK_EQ(hh(1, 1), 0.3125);
+
+    // shapes whose element count does not fit in index_t are rejected up front
+    const index_t big = index_t {1} << 40;
+    bool thrown = false;
+    try {
+        matrix<int> m {big, big};
+    } catch (const std::length_error&) {
+        thrown = true;
+    }
+    if (!thrown) exit(1);
+
+    thrown = false;
+    matrix<int> tall {1, 1};
+    try {
+        tall.reserve(big, big);
+    } catch (const std::length_error&) {
+        thrown = true;
+    }
+    if (!thrown) exit(1);
+
+    // storage is sized exactly, not rounded up to the next growth step
+    CHECK_EQ((matrix<int> {1000, 3}).capacity(), 3000);
+    CHECK_EQ((matrix<int> {1000, 3, uninitialized}).capacity(), 3000);
+
+    // Past 2^31 elements, and a product whose shape overflows. The storage
+    // is left uninitialized and (but for one page) never touched, so this
+    // only needs address space; hosts that refuse it skip the check.
+    try {
+        const index_t r = index_t {1} << 32;
+        const index_t c = (index_t {1} << 31) + 1;
+        matrix<signed char> wide {65537, 32768, uninitialized};
+        wide(65537, 32768) = 7;
+        CHECK_EQ(int(wide(65537, 32768)), 7);
+        CHECK_EQ(&wide(65537, 32768) - wide.data(), (index_t {1} << 31) + 32767);
+
+        matrix<signed char> col {r, 1, uninitialized};
+        matrix<signed char> row {1, c, uninitialized};
+        thrown = false;
+        try {
+            auto p = col * row;
+        } catch (const std::length_error&) {
+            thrown = true;
+        }
+        if (!thrown) exit(1);
+    } catch (const std::bad_alloc&) {
+        std::cout << "skipped: no address space for 64-bit shapes" << std::endl;
+    }
+    std::cout << "End test: Shape overflow PASS" << std::endl;
+}
+
+void test_numa_alloc()
+{
+    std::cout << "Start test: NUMA placement and parallel first touch" << std::endl;
+    set_parallel_threads(4);
+    const index_t nr = 4096, nc = 64;
+    for (auto policy : {numa_policy::first_touch, numa_policy::interleave, numa_policy::bind}) {
+        matrix<double> m {nr, nc, policy, numa_online_nodes().back()};
+        CHECK_EQ(m.rows(), nr);
+        if (!m.contiguous()) exit(1);
+        CHECK_EQ(max(m), 0.0);
+        CHECK_EQ(min(m), 0.0);
+    }
+    set_parallel_threads(0);
+
+    matrix<int> u {NROWS1, NCLMS1, uninitialized};
+    init_matrix1<int, NCLMS1>(u, a1, NROWS1);
+    CHECK_EQ(sum(u), 70);
+
+    bool thrown = false;
+    try {
+        matrix<int> m {2, 2, numa_policy::bind, numa_online_nodes().back() + 1};
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    if (!thrown) exit(1);
+    // only bind has a target node: the others take any, as if there were no node 0
+    matrix<int> ti {2, 2, numa_policy::interleave, numa_online_nodes().back() + 1};
+    matrix<int> tf {2, 2, numa_policy::first_touch, -1};
+    CHECK_EQ(sum(ti) + sum(tf), 0);
+
+    // node lists may have holes once a node goes offline
+    if (numa_parse_node_list("0") != std::vector<int> {0}) exit(1);
+    if (numa_parse_node_list("0,2") != std::vector<int> {0, 2}) exit(1);
+    if (numa_parse_node_list("0-1,4,6-7") != std::vector<int> {0, 1, 4, 6, 7}) exit(1);
+    CHECK_EQ(numa_node_count(), int(numa_online_nodes().size()));
+
+    // pinned, every chunk runs on its own fixed CPU, and a second split of
+    // the same range puts each chunk on the same CPU again
+    set_parallel_threads(4);
+    set_parallel_pinning(thread_pinning::always);
+    const int nchunks = parallel_chunks(nr, parallel_row_grain(nc));
+    CHECK_EQ(nchunks, 4);
+    for (int pass = 0; pass < 2; ++pass) {
+        std::vector<int> cpus(nchunks, -2);
+        parallel_for(nr, parallel_row_grain(nc), [&](int c, index_t, index_t) {
+            cpus[c] = sched_getcpu();
+        });
+        for (int c = 0; c < nchunks; ++c) {
+            if (parallel_chunk_cpu(c, nchunks) >= 0)
+                CHECK_EQ(cpus[c], parallel_chunk_cpu(c, nchunks));
+        }
+    }
+    matrix<double> pinned {nr, nc, numa_policy::first_touch};
+    CHECK_EQ(sum(pinned), 0.0);
+    set_parallel_pinning(thread_pinning::numa_only);
+    set_parallel_threads(0);
+    std::cout << "End test: NUMA placement and parallel first touch PASS" << std::endl;
+}
+
+void test_elementwise()
+{
+    std::cout << "Start test: Elementwise and broadcasting" << std::endl;
+    matrix<int> m1 {NROWS1, NCLMS1};
+    init_matrix1<int, NCLMS1>(m1, a1, NROWS1);
+    matrix<int> m2 {NROWS1, NCLMS1};
+    init_matrix1<int, NCLMS1>(m2, a2, NROWS1);
+    matrix<int> mexp {NROWS1, NCLMS1};
+    init_matrix1<int, NCLMS1>(mexp, a1a2_add_res, NROWS1);
+
+    if (!check_eq(add(m1, m2), mexp)) exit(1);
+    if (!check_eq(zip_with(m1, m2, [](int x, int y) {return x + y;}), mexp)) exit(1);
+    if (!check_eq(subtract(mexp, m2), m1)) exit(1);
+    CHECK_EQ(hadamard(m1, m2)(3, 4), 11 * 21);
+    CHECK_EQ(map(m1, [](int x) {return 0.5 * x;})(2, 1), 2.0);
+    if (!check_eq((m1 * 2 + 1 - 1) / 2, m1)) exit(1);
+    if (!check_eq(2 * m1, m1 + m1)) exit(1);
+
+    // broadcasting a column mean and a row of column sums
+    auto centered = subtract(map(m1, [](int x) {return double(x);}), mean(m1, per::row));
+    CHECK_EQ(sum(centered), 0.0);
+    CHECK_EQ(centered(1, 1), -1.5);
+    auto scaled = hadamard(m1, sum(m1, per::column));
+    CHECK_EQ(scaled(3, 2), 9 * 16);
+    bool thrown = false;
+    try {
+        add(m1, m1.transpose());
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    if (!thrown) exit(1);
+
+    // in place on a padded, hash-tracked matrix
+    matrix<int> mp = m1;
+    mp.append_column(Vector<int> {0, 0, 0});
+    mp.track_content_hash();
+    mp.content_hash();
+    mp *= 3;
+    mp -= 1;
+    CHECK_EQ(mp(3, 4), 32);
+    CHECK_EQ(mp(3, 5), -1);
+    matrix<int> mq = mp;
+    mq.shrink_to_fit();
+    mq.track_content_hash(false);
+    CHECK_EQ(mp.content_hash(), mq.content_hash());
+
+    // transcendental kernels against the C library, over a range split across threads
+    set_parallel_threads(4);
+    const int n = 1 << 16;
+    matrix<double> x {n, 2};
+    for (int i = 1; i <= n; ++i) {
+        x(i, 1) = (i - n / 2) * (700.0 / n);
+        x(i, 2) = std::ldexp(1.0 + double(i) / n, i % 2000 - 1000);
+    }
+    auto ref = [&x](double (*f)(double)) {
+        matrix<double> r {n, 2};
+        for (int i = 1; i <= n; ++i)
+            for (int j = 1; j <= 2; ++j)
+                r(i, j) = f(x(i, j));
+        return r;
+    };
+    const tolerance ulps {.ulps = 4};
+    if (!approx_equal(exp(x), ref([](double v) {return std::exp(v);}), ulps)) exit(1);
+    if (!approx_equal(tanh(x), ref([](double v) {return std::tanh(v);}), ulps)) exit(1);
+    if (!approx_equal(sqrt(map(x, [](double v) {return std::abs(v);})),
+                      map(x, [](double v) {return std::sqrt(std::abs(v));}))) exit(1);
+    auto lx = log(map(x, [](double v) {return std::abs(v);}));
+    if (!approx_equal(lx, ref([](double v) {return std::log(std::abs(v));}), ulps)) exit(1);
+    set_parallel_threads(0);
+
+    matrix<double> s {1, 6};
+    const double special[] = {0.0, -1.0, INFINITY, -INFINITY, NAN, 4.9e-324};
+    for (int j = 0; j < 6; ++j)
+        s(1, j + 1) = special[j];
+    auto es = exp(s), ls = log(s), ts = tanh(s);
+    CHECK_EQ(es(1, 1), 1.0);
+    CHECK_EQ(es(1, 3), INFINITY);
+    CHECK_EQ(es(1, 4), 0.0);
+    if (!std::isnan(es(1, 5)) || !std::isnan(ls(1, 2)) || !std::isnan(ts(1, 5))) exit(1);
+    CHECK_EQ(ls(1, 1), -INFINITY);
+    CHECK_EQ(ls(1, 3), INFINITY);
+    CHECK_EQ(ls(1, 6), std::log(4.9e-324));
+    CHECK_EQ(ts(1, 3), 1.0);
+    CHECK_EQ(ts(1, 4), -1.0);
+    if (!std::signbit(tanh(map(s, [](double v) {return -v;}))(1, 1))) exit(1);
+
+    // long double goes through the C library at its own precision
+    matrix<long double> lds {1, 2};
+    lds(1, 1) = 1.0L;
+    lds(1, 2) = 0.5L;
+    CHECK_EQ(exp(lds)(1, 1), std::exp(lds(1, 1)));
+    CHECK_EQ(log(lds)(1, 2), std::log(lds(1, 2)));
+    CHECK_EQ(tanh(lds)(1, 2), std::tanh(lds(1, 2)));
+    std::cout << "End test: Elementwise and broadcasting PASS" << std::endl;
+}
+
+void test_chain_power()
+{
+    std::cout << "Start test: Matrix chain and power" << std::endl;
+    matrix<int> m1 {NROWS1, NCLMS1};
+    init_matrix1<int, NCLMS1>(m1, a1, NROWS1);
+    matrix<int> m2 {NROWS1_P, NCLMS1_P};
+    init_matrix1<int, NCLMS1_P>(m2, a1_p, NROWS1_P);
+    matrix<int> ms {NROWS_S1, NCLMS_S1};
+    init_matrix1<int, NCLMS_S1>(ms, as1, NROWS_S1);
+
+    // the textbook example: (a * b) * c costs 7500, a * (b * c) 75000
+    CHECK_EQ(chain_cost({10, 100, 5, 50}), 7500.0);
+    CHECK_EQ(chain_cost({10, 100, 5}), 5000.0);
+    CHECK_EQ(chain_cost({10, 100}), 0.0);
+
+    const matrix<int> m1t = m1.transpose();
+    if (!check_eq(multiply_chain(m1), m1)) exit(1);
+    if (!check_eq(multiply_chain(m1, m2), m1 * m2)) exit(1);
+    if (!check_eq(multiply_chain(m1t, m1, m1t, m1), m1t * m1 * m1t * m1)) exit(1);
+
+    // a padded operand and a longer chain of alternating shapes
+    matrix<int> padded = m1;
+    padded.reserve(NROWS1, NCLMS1 + 5);
+    if (padded.contiguous()) exit(1);
+    if (!check_eq(multiply_chain(m1t, padded, m1t), m1t * m1 * m1t)) exit(1);
+    auto wide = [](const matrix<int>& m) {return map(m, [](int x) {return (long long) x;});};
+    const matrix<long long> l1 = wide(m1), l1t = wide(m1t);
+    std::vector<matrix<long long>> chain {l1t, wide(padded), l1t, l1, l1t * l1, wide(m2)};
+    if (!check_eq(multiply_chain(chain), l1t * l1 * l1t * l1 * (l1t * l1) * wide(m2))) exit(1);
+
+    // swap exchanges everything, tracking included, without moving elements
+    matrix<int> sa = m1;
+    matrix<int> sb = ms;
+    sa.track_content_hash();
+    const int* pa = sa.data();
+    sa.swap(sb);
+    if (!check_eq(sa, ms) || !check_eq(sb, m1)) exit(1);
+    if (sa.content_hash_tracked() || !sb.content_hash_tracked()) exit(1);
+    if (sb.data() != pa) exit(1);
+    CHECK_EQ(sb.content_hash(), m1.content_hash());
+    swap(sa, sb);
+    if (!check_eq(sa, m1) || !check_eq(sb, ms)) exit(1);
+
+    if (!check_eq(pow(ms, 1), ms)) exit(1);
+    if (!check_eq(pow(ms, 5), ms * ms * ms * ms * ms)) exit(1);
+    if (!check_eq(pow(ms, 4), ms * ms * ms * ms)) exit(1);
+    matrix<int> id = pow(ms, 0);
+    if (!check_eq(id * ms, ms)) exit(1);
+
+    // Fibonacci numbers: [[1, 1], [1, 0]]^k holds F(k) off the diagonal
+    matrix<long long> fib {2, 2};
+    fib(1, 1) = fib(1, 2) = fib(2, 1) = 1;
+    CHECK_EQ(pow(fib, 40)(1, 2), 102334155LL);
+    CHECK_EQ(pow(fib, 90)(1, 2), 2880067194370816120LL);
+
+    int thrown = 0;
+    try {
+        multiply_chain(m1, m1);
+    } catch (const std::invalid_argument&) {
+        ++thrown;
+    }
+    try {
+        pow(m1, 2);
+    } catch (const std::invalid_argument&) {
+        ++thrown;
+    }
+    try {
+        pow(ms, -1);
+    } catch (const std::invalid_argument&) {
+        ++thrown;
+    }
+    CHECK_EQ(thrown, 3);
+    std::cout << "End test: Matrix chain and power PASS" << std::endl;
+}
+
+void test_structured_symmetric()
+{
+    std::cout << "Start test: Structured symmetric" << std::endl;
+    matrix<int> md {NROWS_S1, NCLMS_S1};
+    init_matrix1<int, NCLMS_S1>(md, asym, NROWS_S1);
+    matrix<int> mb {NROWS_S1, NCLMS_S1};
+    init_matrix1<int, NCLMS_S1>(mb, as1, NROWS_S1);
+
+    symmetric_matrix<int> s {md};
+    CHECK_EQ(s(1, 3), s(3, 1));
+    if (!(s == md) || !(md == s.to_dense())) exit(1);
+    if (!(s.transpose() == s)) exit(1);
+
+    // structured kernels against the dense ones
+    if (!check_eq(s * mb, md * mb)) exit(1);
+    if (!check_eq(mb * s, mb * md)) exit(1);
+    if (!check_eq(s + mb, md + mb)) exit(1);
+    if (!check_eq(mb - s, mb - md)) exit(1);
+    if (!((s + s) == md + md)) exit(1);
+    std::cout << "End test: Structured symmetric PASS" << std::endl;
+}
+
+void test_structured_triangular()
+{
+    std::cout << "Start test: Structured triangular" << std::endl;
+    matrix<int> ma {NROWS_S1, NCLMS_S1};
+    init_matrix1<int, NCLMS_S1>(ma, as1, NROWS_S1);
+
+    upper_triangular<int> u {ma};
+    lower_triangular<int> l {ma};
+    CHECK_EQ(u(1, 3), 2);
+    CHECK_EQ(std::as_const(u)(3, 1), 0);
+    CHECK_EQ(l(3, 1), 12);
+
+    matrix<int> mu = u.to_dense();
+    matrix<int> ml = l.to_dense();
+    if (!(u.transpose() == lower_triangular<int> {mu.transpose()})) exit(1);
+    if (!(l.transpose() == ml.transpose())) exit(1);
+    if (!check_eq(u * ma, mu * ma)) exit(1);
+    if (!check_eq(ma * l, ma * ml)) exit(1);
+    if (!((u * u) == mu * mu)) exit(1);
+    if (!((l * l) == ml * ml)) exit(1);
+    if (!check_eq(u * l, mu * ml)) exit(1);
+    if (!check_eq(u + l, mu + ml)) exit(1);
+
+    // writing an implicit zero is rejected
+    try {
+        u(3, 1) = 1;
+        exit(1);
+    } catch (const std::invalid_argument&) {}
+    std::cout << "End test: Structured triangular PASS" << std::endl;
+}
+
+void test_structured_diagonal_banded()
+{
+    std::cout << "Start test: Structured diagonal and banded" << std::endl;
+    matrix<int> ma {NROWS_S1, NCLMS_S1};
+    init_matrix1<int, NCLMS_S1>(ma, as1, NROWS_S1);
+
+    diagonal_matrix<int> d {ma};
+    matrix<int> md = d.to_dense();
+    if (!check_eq(d * ma, md * ma)) exit(1);
+    if (!check_eq(ma * d, ma * md)) exit(1);
+    if (!((d * d) == md * md)) exit(1);
+    if (!check_eq(ma + d, ma + md)) exit(1);
+
+    banded_matrix<int> b1 {ma, 1, 0};
+    banded_matrix<int> b2 {ma, 0, 1};
+    matrix<int> mb1 = b1.to_dense();
+    matrix<int> mb2 = b2.to_dense();
+    CHECK_EQ(std::as_const(b1)(3, 1), 0);
+    CHECK_EQ(b1(3, 2), 19);
+    if (!(b1.transpose() == mb1.transpose())) exit(1);
+    if (!check_eq(b1 * ma, mb1 * ma)) exit(1);
+    if (!check_eq(ma * b2, ma * mb2)) exit(1);
+    if (!((b1 * b2) == mb1 * mb2)) exit(1);
+    if (!((b1 + b2) == mb1 + mb2)) exit(1);
+    if (!((b1 - b2) == mb1 - mb2)) exit(1);
+    if (!check_eq(d * b1, md * mb1)) exit(1);
+    if (b1 == b2) exit(1);
+    std::cout << "End test: Structured diagonal and banded PASS" << std::endl;
+}
+
+void test_reductions()
+{
+    std::cout << "Start test: Reductions" << std::endl;
+    matrix<int> m {NROWS1, NCLMS1};
+    init_matrix1<int, NCLMS1>(m, a1, NROWS1);
+
+    CHECK_EQ(sum(m), 70);
+    CHECK_EQ(min(m), 1);
+    CHECK_EQ(max(m), 11);
+    if (argmax(m) != std::make_pair<index_t, index_t>(NROWS1, NCLMS1)) exit(1);
+    CHECK_EQ(product(m.transpose(), per::column)(1, 1), 1 * 2 * 3 * 4);
+    CHECK_EQ(mean(m), 70.0 / 12);
+
+    constexpr int row_sums[NROWS1][1] = {{10}, {22}, {38}};
+    constexpr int clm_sums[1][NCLMS1] = {{13, 16, 19, 22}};
+    matrix<int> mrow {NROWS1, 1};
+    init_matrix1<int, 1>(mrow, row_sums, NROWS1);
+    matrix<int> mclm {1, NCLMS1};
+    init_matrix1<int, NCLMS1>(mclm, clm_sums, 1);
+    if (!check_eq(sum(m, per::row), mrow)) exit(1);
+    if (!check_eq(sum(m, per::column), mclm)) exit(1);
+    if (!check_eq(sum(m.transpose(), per::row), mclm.transpose())) exit(1);
+
+    CHECK_EQ(argmin(m, per::row)[NROWS1-1], 1);
+    CHECK_EQ(argmax(m, per::column)[0], NROWS1);
+    CHECK_EQ(max(m, per::row)(2, 1), 7);
+    CHECK_EQ(min(m, per::column)(1, 4), 4);
+    CHECK_EQ(variance(m, per::column)(1, 1), variance(m.transpose(), per::row)(1, 1));
+    CHECK_EQ(mean(m, per::row)(1, 1), 2.5);
+
+    // large enough to be split across threads, pairwise/Kahan keep float sums exact-ish
+    set_parallel_threads(4);
+    const int n = 1 << 17;
+    matrix<float> f {n, 2};
+    for (int i = 1; i <= n; ++i) {
+        f(i, 1) = 0.1f;
+        f(i, 2) = i % 2 ? 1.0f : 3.0f;
+    }
+    if (std::abs(sum(f) - (0.1 * n + 2.0 * n)) > 1e-5 * n) exit(1);
+    if (std::abs(sum(f, per::column)(1, 1) - 0.1 * n) > 1e-6 * n) exit(1);
+    if (std::abs(variance(f, per::column)(1, 2) - 1.0f) > 1e-5f) exit(1);
+    if (argmax(f) != std::make_pair<index_t, index_t>(2, 2)) exit(1);
+
+    // f is tall and narrow, so column reductions split it into row blocks;
+    // the merged blocks must agree with a single sweep
+    matrix<int> g {n, 3};
+    for (int i = 1; i <= n; ++i) {
+        g(i, 1) = i % 7;
+        g(i, 2) = (i * 37) % 1001 - 500;
+        g(i, 3) = i % 2 ? 1 : -1;
+    }
+    auto gsum = sum(g, per::column);
+    auto gmin = min(g, per::column);
+    auto gmax = max(g, per::column);
+    auto gargmax = argmax(g, per::column);
+    matrix<int> signs {n, 2};
+    for (int i = 1; i <= n; ++i) {
+        signs(i, 1) = i % 2 ? 1 : -1;
+        signs(i, 2) = i % 5 ? 1 : -1;
+    }
+    auto sprod = product(signs, per::column);
+    auto fvar = variance(f, per::column);
+    set_parallel_threads(1);
+    if (!check_eq(gsum, sum(g, per::column))) exit(1);
+    if (!check_eq(gmin, min(g, per::column))) exit(1);
+    if (!check_eq(gmax, max(g, per::column))) exit(1);
+    if (!check_eq(sprod, product(signs, per::column))) exit(1);
+    for (int j = 0; j < 3; ++j)
+        CHECK_EQ(gargmax[j], argmax(g, per::column)[j]);
+    CHECK_EQ(gargmax[0], 6);    // first of the ties
+    if (std::abs(fvar(1, 2) - variance(f, per::column)(1, 2)) > 1e-6f) exit(1);
+    set_parallel_threads(4);
+
+    // integral sums accumulate in 64 bits, so only the total has to fit
+    matrix<int> big {1, 3};
+    big(1, 1) = std::numeric_limits<int>::max();
+    big(1, 2) = std::numeric_limits<int>::max();
+    big(1, 3) = -std::numeric_limits<int>::max();
+    CHECK_EQ(sum(big), std::numeric_limits<int>::max());
+    CHECK_EQ(sum(big, per::row)(1, 1), std::numeric_limits<int>::max());
+    CHECK_EQ(sum(big.transpose(), per::column)(1, 1), std::numeric_limits<int>::max());
+
+    Vector<double> v {3.0, 4.0};
+    CHECK_EQ(norm(v), 5.0);
+    CHECK_EQ(argmin(v), 0);
+    CHECK_EQ(variance(v, 1), 0.5);
+    set_parallel_threads(0);
+    std::cout << "End test: Reductions PASS" << std::endl;
+}
+
+void test_compare()
+{
+    std::cout << "Start test: Compare" << std::endl;
+    matrix<int> m1 {NROWS1, NCLMS1};
+    init_matrix1<int, NCLMS1>(m1, a1, NROWS1);
+    matrix<int> m2 {NROWS1, NCLMS1};
+    init_matrix1<int, NCLMS1>(m2, a2, NROWS1);
+
+    if (m1 == m2 || !equal(m1, m1, exec::parallel)) exit(1);
+    CHECK_EQ(fingerprint(m1), fingerprint(+m1));
+    if (fingerprint(m1) == fingerprint(m2)) exit(1);
+    if (fingerprint(m1) == fingerprint(m1.transpose())) exit(1);
+    if (!approx_equal(m1, m2, tolerance {.abs = 10})) exit(1);
+    if (approx_equal(m1, m2, tolerance {.abs = 9})) exit(1);
+
+    matrix<double> d1 {2, 2};
+    d1(1, 1) = 1.0;
+    d1(2, 2) = -0.0;
+    matrix<double> d2 = d1;
+    d2(2, 2) = 0.0;
+    if (!(d1 == d2)) exit(1);
+    CHECK_EQ(fingerprint(d1), fingerprint(d2));
+
+    d2(1, 1) = std::nextafter(std::nextafter(1.0, 2.0), 2.0);
+    if (d1 == d2 || approx_equal(d1, d2)) exit(1);
+    if (approx_equal(d1, d2, tolerance {.ulps = 1})) exit(1);
+    if (!approx_equal(d1, d2, tolerance {.ulps = 2})) exit(1);
+    if (!approx_equal(d1, d2, tolerance {.rel = 1e-15})) exit(1);
+
+    d2(1, 1) = std::nan("");
+    if (approx_equal(d2, d2, tolerance {.abs = 1, .ulps = 4})) exit(1);
+
+    // long double has no integer of its width: its ULPs are counted
+    matrix<long double> l1 {1, 4};
+    l1(1, 1) = 1.0L;
+    l1(1, 2) = -std::numeric_limits<long double>::denorm_min();
+    l1(1, 3) = std::numeric_limits<long double>::max();
+    l1(1, 4) = std::nextafter(2.0L, 0.0L);
+    matrix<long double> l2 = l1;
+    if (!approx_equal(l1, l2)) exit(1);
+    l2(1, 1) = std::nextafter(1.0L, 2.0L);
+    if (approx_equal(l1, l2) || approx_equal(l1, l2, tolerance {.abs = 1e-20})) exit(1);
+    if (!approx_equal(l1, l2, tolerance {.ulps = 1})) exit(1);
+    l2(1, 2) = std::numeric_limits<long double>::denorm_min();
+    l2(1, 3) = INFINITY;
+    l2(1, 4) = std::nextafter(2.0L, 3.0L);
+    if (approx_equal(l1, l2, tolerance {.ulps = 1})) exit(1);
+    if (!approx_equal(l1, l2, tolerance {.ulps = 2})) exit(1);
+    l2(1, 1) = std::nextafter(1.0L, 0.0L);
+    l2(1, 4) = 1.5L;
+    if (approx_equal(l1, l2, tolerance {.ulps = (std::int64_t {1} << 62) - 2})) exit(1);
+    if (!approx_equal(l1, l2, tolerance {.ulps = (std::int64_t {1} << 62) - 1})) exit(1);
+
+    // large enough to be split across threads
+    set_parallel_threads(4);
+    const int n = 1 << 17;
+    matrix<float> f1 {n, 2};
+    matrix<float> f2 {n, 2};
+    f2(n, 2) = 1e-7f;
+    if (equal(f1, f2, exec::parallel)) exit(1);
+    if (!approx_equal(f1, f2, tolerance {.abs = 1e-6}, exec::parallel)) exit(1);
+    if (fingerprint(f1) == fingerprint(f2)) exit(1);
+    f2(n, 2) = 0;
+    if (!equal(f1, f2, exec::parallel)) exit(1);
+    CHECK_EQ(fingerprint(f1), fingerprint(f2));
+    set_parallel_threads(0);
+    std::cout << "End test: Compare PASS" << std::endl;
+}
+
+void test_content_hash()
+{
+    std::cout << "Start test: Tracked content hash" << std::endl;
+    matrix<int> m1 {NROWS1, NCLMS1};
+    init_matrix1<int, NCLMS1>(m1, a1, NROWS1);
+    matrix<int> m2 {NROWS1, NCLMS1};
+    init_matrix1<int, NCLMS1>(m2, a2, NROWS1);
+
+    matrix<int> mt = m1;
+    mt.track_content_hash();
+    CHECK_EQ(mt.content_hash(), m1.content_hash());
+
+    mt(2, 3) = 0;       // marks row 2 stale
+    m1(2, 3) = 0;
+    CHECK_EQ(mt.content_hash(), m1.content_hash());
+
+    mt += m2;           // rehashed in the same pass
+    m1 += m2;
+    CHECK_EQ(mt.content_hash(), m1.content_hash());
+    mt -= m2;
+    if (mt.content_hash() == m1.content_hash()) exit(1);
+    m1 -= m2;
+    CHECK_EQ(mt.content_hash(), m1.content_hash());
+
+    // assignment keeps the target's tracking, copies inherit the source's
+    mt = m2;
+    if (!mt.content_hash_tracked() || m1.content_hash_tracked()) exit(1);
+    CHECK_EQ(mt.content_hash(), m2.content_hash());
+    matrix<int> mc = mt;
+    if (!mc.content_hash_tracked()) exit(1);
+    CHECK_EQ(mc.content_hash(), m2.content_hash());
+
+    // writes count once the reference or pointer is taken again after a hash
+    int& held = mt(1, 1);
+    const std::uint64_t before = mt.content_hash();
+    held += 1;
+    mt(1, 1) = held;
+    if (mt.content_hash() == before) exit(1);
+    m2(1, 1) += 1;
+    CHECK_EQ(mt.content_hash(), m2.content_hash());
+    mt.data()[1] = m2(1, 2) = -7;
+    CHECK_EQ(mt.content_hash(), m2.content_hash());
+
+    // long double spans two words; padding bytes after its value are ignored
+    matrix<long double> l1 {2, 2};
+    matrix<long double> l2 {2, 2};
+    std::memset(static_cast<void*>(l2.data()), 0xff, 4 * sizeof(long double));
+    for (int i = 1; i <= 2; ++i) {
+        for (int j = 1; j <= 2; ++j)
+            l1(i, j) = l2(i, j) = 1.0L + i * j;
+    }
+    CHECK_EQ(l1.content_hash(), l2.content_hash());
+    l2(2, 2) = 2 * l2(2, 2);    // same 64-bit mantissa, different exponent word
+    if (l1.content_hash() == l2.content_hash()) exit(1);
+    std::cout << "End test: Tracked content hash PASS" << std::endl;
+}
+
+void test_product_cache()
+{
+    std::cout << "Start test: Product cache" << std::endl;
+    matrix<int> m1 {NROWS1, NCLMS1};
+    init_matrix1<int, NCLMS1>(m1, a1, NROWS1);
+    matrix<int> m2 {NROWS1_P, NCLMS1_P};
+    init_matrix1<int, NCLMS1_P>(m2, a1_p, NROWS1_P);
+    m1.track_content_hash();
+
+    matrix_cache<int> cache {1 << 20};
+    auto r1 = cache.multiply(m1, m2);
+    auto r2 = cache.multiply(m1, m2);
+    if (r1 != r2 || !(*r1 == m1 * m2)) exit(1);
+    CHECK_EQ(cache.statistics().hits, 1UL);
+    CHECK_EQ(cache.statistics().misses, 1UL);
+
+    m1(1, 1) = 100;     // different operand, different key
+    auto r3 = cache.multiply(m1, m2);
+    if (r3 == r1 || !(*r3 == m1 * m2)) exit(1);
+    CHECK_EQ(cache.statistics().entries, 2UL);
+
+    // a write through a pointer taken after the lookup is seen by the next one
+    int* p1 = m1.data();
+    p1[1] = 50;
+    auto r4 = cache.multiply(m1, m2);
+    if (r4 == r3 || !(*r4 == m1 * m2)) exit(1);
+
+    // a budget for one result evicts the least recently used one
+    matrix_cache<int> small {sizeof(matrix<int>) + sizeof(int) * (m1 * m2).capacity()};
+    small.multiply(m1, m2);
+    small.multiply(m2.transpose(), m1.transpose());
+    CHECK_EQ(small.statistics().entries, 1UL);
+    CHECK_EQ(small.statistics().evictions, 1UL);
+    CHECK_EQ(small.statistics().bytes, sizeof(matrix<int>) + sizeof(int) * (m1 * m2).capacity());
+
+    // padding and reserved rows are charged too
+    matrix_cache<int> wide {1 << 20};
+    auto padded = wide.get_or_compute(MATRIX_CACHE_OP_USER, m1, m2, [](const matrix<int>& a, const matrix<int>& b) {
+        matrix<int> r = a * b;
+        r.reserve(2 * r.rows(), 2 * r.columns());
+        return r;
+    });
+    if (padded->capacity() < 4 * NROWS1 * NCLMS1_P) exit(1);
+    CHECK_EQ(wide.statistics().bytes, sizeof(matrix<int>) + sizeof(int) * padded->capacity());
+    small.clear();
+    CHECK_EQ(small.statistics().bytes, 0UL);
+
+    // threads sharing a stale tracked operand all find the entry stored
+    // for its new contents (computed up front, so nothing prints from them)
+    for (int round = 0; round < 8; ++round) {
+        m1(1, 1) = round;
+        matrix<int> fresh = m1;
+        fresh.track_content_hash(false);
+        auto expected = cache.multiply(fresh, m2);
+        bool hit[4] = {};
+        std::vector<std::thread> threads;
+        for (bool& h : hit)
+            threads.emplace_back([&] {h = cache.multiply(m1, m2) == expected;});
+        for (std::thread& t : threads)
+            t.join();
+        for (bool h : hit)
+            if (!h) exit(1);
+    }
+    std::cout << "End test: Product cache PASS" << std::endl;
+}
+
+void test_resize()
+{
+    std::cout << "Start test: Append/insert/erase rows and columns" << std::endl;
+    matrix<int> m1 {NROWS1, NCLMS1};
+    init_matrix1<int, NCLMS1>(m1, a1, NROWS1);
+
+    // rebuild a1 from an empty matrix: rows 1 and 3, then row 2 in between
+    matrix<int> m {0, 0};
+    m.reserve(NROWS1, NCLMS1);
+    m.append_row(Vector<int> {1, 2, 3, 4});
+    m.append_row(Vector<int> {8, 9, 10, 11});
+    m.insert_row(2, Vector<int> {4, 5, 6, 7});
+    if (!check_eq(m, m1) || !m.contiguous()) exit(1);
+
+    // column appends go into the row padding
+    m.append_column(Vector<int> {5, 8, 12});
+    CHECK_EQ(m.columns(), NCLMS1 + 1);
+    if (m.stride() <= m.columns()) exit(1);
+    CHECK_EQ(m(3, 5), 12);
+    m.insert_column(1, Vector<int> {0, 3, 7});
+    CHECK_EQ(m(2, 1), 3);
+    CHECK_EQ(m(2, 2), 4);
+
+    // a padded matrix behaves like its compact copy
+    matrix<int> mc = m;
+    mc.shrink_to_fit();
+    if (!mc.contiguous() || m.contiguous()) exit(1);
+    if (!check_eq(m, mc)) exit(1);
+    CHECK_EQ(fingerprint(m), fingerprint(mc));
+    CHECK_EQ(sum(m), sum(mc));
+    if (argmax(m) != argmax(mc)) exit(1);
+    if (!check_eq(sum(m, per::column), sum(mc, per::column))) exit(1);
+    if (!check_eq(m.transpose() * m, mc.transpose() * mc)) exit(1);
+    if (!approx_equal(m, mc, tolerance {}, exec::parallel)) exit(1);
+    if (!check_eq(m + m, mc + mc)) exit(1);
+
+    m.erase_column(1);
+    m.erase_column(NCLMS1 + 1);
+    if (!check_eq(m, m1)) exit(1);
+    m.erase_row(2);
+    CHECK_EQ(m.rows(), NROWS1 - 1);
+    CHECK_EQ(m(2, 4), 11);
+    m.erase_row(1);
+    m.erase_row(1);
+    CHECK_EQ(m.rows(), 0);
+    CHECK_EQ(m.columns(), 0);
+
+    // the tracked hash only rehashes what changed, and stays exact
+    matrix<int> mt = m1;
+    mt.track_content_hash();
+    mt.content_hash();
+    mt.append_row(Vector<int> {1, 1, 1, 1});
+    mt.append_column(Vector<int> {2, 2, 2, 2});
+    matrix<int> mu = mt;
+    mu.track_content_hash(false);
+    CHECK_EQ(mt.content_hash(), mu.content_hash());
+
+    // unary minus leaves the padding alone: no -0.0 in it
+    matrix<double> d {2, 2};
+    d.append_column(Vector<double> {1.0, 2.0});
+    if (d.contiguous()) exit(1);
+    -d;
+    CHECK_EQ(d(2, 3), -2.0);
+    const double* pd = d.data();
+    for (index_t i = 0; i < d.rows(); ++i) {
+        for (index_t j = d.columns(); j < d.stride(); ++j) {
+            if (std::signbit(pd[i * d.stride() + j])) exit(1);
+        }
+    }
+
+    // erasing the first, a middle or the last row drops it from the tracked total
+    for (index_t row : {index_t {1}, index_t {2}, index_t {NROWS1}}) {
+        matrix<int> et = m1;
+        et.track_content_hash();
+        et.content_hash();
+        matrix<int> eu = m1;
+        et.erase_row(row);
+        eu.erase_row(row);
+        CHECK_EQ(et.content_hash(), eu.content_hash());
+    }
+    matrix<int> single {1, NCLMS1};
+    single.track_content_hash();
+    single.content_hash();
+    single.erase_row(1);
+    CHECK_EQ(single.content_hash(), (matrix<int> {0, 0}).content_hash());
+
+    // columns appended to an empty matrix use the reserved stride
+    matrix<int> mr {0, 0};
+    mr.reserve(0, NCLMS1);
+    mr.append_column(Vector<int> {1, 4, 8, 2, 5, 9});
+    CHECK_EQ(mr.rows(), 6);
+    CHECK_EQ(mr.stride(), NCLMS1);
+    CHECK_EQ(mr(6, 1), 9);
+    mr.append_column(Vector<int> {0, 0, 0, 0, 0, 7});
+    CHECK_EQ(mr.stride(), NCLMS1);
+    CHECK_EQ(mr(5, 1), 5);
+    CHECK_EQ(mr(6, 2), 7);
+    CHECK_EQ(sum(mr), 36);
+    std::cout << "End test: Append/insert/erase rows and columns PASS" << std::endl;
+}
+
+void test_vector_ranges()
+{
+    std::cout << "Start test: Vector range operations" << std::endl;
+    const int r[] = {10, 11, 12, 13, 14, 15};
+    Vector<int> v {1, 2, 3};
+    v.insert(1, r, r + 6);
+    CHECK_EQ(v.size(), 9);
+    CHECK_EQ(v[0], 1);
+    CHECK_EQ(v[1], 10);
+    CHECK_EQ(v[6], 15);
+    CHECK_EQ(v[7], 2);
+    v.append(r, r + 2);
+    CHECK_EQ(v[10], 11);
+    v.erase(1, 7);
+    CHECK_EQ(v.size(), 5);
+    CHECK_EQ(v[1], 2);
+    CHECK_EQ(v[4], 11);
+    v.assign(r + 3, r + 6);
+    CHECK_EQ(v.size(), 3);
+    CHECK_EQ(v[2], 15);
+
+    // no automatic shrinking: the capacity survives emptying the list
+    Vector<int> big (4);
+    big.set_shrink_threshold(0);
+    for (int i = 0; i < 1000; i++) big.push_back(i);
+    const index_t cap = big.capacity();
+    big.erase(0, 999);
+    big.pop_back();
+    CHECK_EQ(big.capacity(), cap);
+    big.set_shrink_threshold(8);
+    big.push_back(1);
+    big.pop_back();
+    CHECK_EQ(big.capacity(), cap / 2);
+    bool thrown = false;
+    try {
+        big.set_shrink_threshold(2);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    if (!thrown) exit(1);
+
+    // inline storage, spilling to the heap and back through copies and moves
+    Vector<double, 4> s;
+    CHECK_EQ(s.capacity(), 4);
+    for (int i = 0; i < 4; i++) s.push_back(i);
+    Vector<double, 4> s2 = std::move(s);
+    CHECK_EQ(s2[3], 3.0);
+    CHECK_EQ(s.size(), 0);
+    s.push_back(7);
+    for (int i = 4; i < 20; i++) s2.push_back(i);
+    Vector<double, 4> s3 = s2;
+    s2 = std::move(s);
+    CHECK_EQ(s2.size(), 1);
+    CHECK_EQ(s2[0], 7.0);
+    s3.erase(2, 20);
+    s3.shrink_to_fit();
+    CHECK_EQ(s3.capacity(), 2);
+    CHECK_EQ(s3[1], 1.0);
+
+    // exact sizing: growth stops at the requested size, shrinking keeps the capacity
+    Vector<int> e;
+    e.resize_exact(1001);
+    CHECK_EQ(e.capacity(), 1001);
+    CHECK_EQ(e[1000], 0);
+    e.resize_exact(5, uninitialized);
+    CHECK_EQ(e.size(), 5);
+    CHECK_EQ(e.capacity(), 1001);
+    std::cout << "End test: Vector range operations PASS" << std::endl;
+}
+
 int main ()
 {
     test_init();
@@ -339,4 +1181,17 @@ int main ()
     test_binary_minus();
     test_transpose();
     test_product();
+    test_shape_overflow();
+    test_numa_alloc();
+    test_elementwise();
+    test_chain_power();
+    test_structured_symmetric();
+    test_structured_triangular();
+    test_structured_diagonal_banded();
+    test_reductions();
+    test_compare();
+    test_content_hash();
+    test_product_cache();
+    test_resize();
+    test_vector_ranges();
 }
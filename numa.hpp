@@ -0,0 +1,115 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// NUMA placement of large buffers, through the raw mbind syscall (no libnuma).
+//
+//      numa_policy::first_touch    -- the kernel default: a page lands on the node
+//                                     of the thread that writes it first
+//      numa_policy::interleave     -- pages round-robin over all nodes
+//      numa_policy::bind           -- all pages on one node
+//
+// Placement only affects pages not touched yet, so apply it right after the
+// allocation and before anything writes the buffer. On hosts with a single
+// node, and off Linux, every policy behaves like first_touch. Node numbers
+// need not be contiguous ("0,2" after node 1 went offline); interleave
+// spreads over the online nodes only.
+
+enum class numa_policy { first_touch, interleave, bind };
+
+// Node numbers in a kernel node list such as "0", "0-3" or "0-1,4,6-7",
+// in increasing order
+inline std::vector<int> numa_parse_node_list (const std::string& list)
+{
+    std::vector<int> nodes;
+    std::size_t pos = 0;
+    while (pos < list.size()) {
+        std::size_t next = list.find(',', pos);
+        if (next == std::string::npos)
+            next = list.size();
+        const std::string item = list.substr(pos, next - pos);
+        pos = next + 1;
+        if (item.empty())
+            continue;
+        const std::size_t dash = item.find('-');
+        const int first = std::stoi(item.substr(0, dash));
+        const int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+        for (int node = first; node <= last; ++node)
+            nodes.push_back(node);
+    }
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    return nodes;
+}
+
+// Online NUMA nodes ({0} when unknown or not on Linux)
+inline const std::vector<int>& numa_online_nodes ()
+{
+    static const std::vector<int> nodes = [] {
+        std::ifstream in {"/sys/devices/system/node/online"};
+        std::string list;
+        std::vector<int> parsed;
+        if (in >> list) {
+            try {
+                parsed = numa_parse_node_list(list);
+            } catch (const std::exception&) {
+                parsed.clear();
+            }
+        }
+        return parsed.empty() ? std::vector<int> {0} : parsed;
+    }();
+    return nodes;
+}
+
+// number of online NUMA nodes (1 when unknown or not on Linux)
+inline int numa_node_count ()
+{
+    return static_cast<int>(numa_online_nodes().size());
+}
+
+// Applies policy to the pages within [p, p + bytes). node is the target of
+// numa_policy::bind, which must be online (std::invalid_argument otherwise);
+// the other policies ignore it. Partial pages at either end are left alone.
+// Returns false if the kernel refused (errno tells why), in which case the
+// pages stay first_touch.
+inline bool numa_place (void* p, std::size_t bytes, numa_policy policy, int node = 0)
+{
+    const std::vector<int>& online = numa_online_nodes();
+    if (policy == numa_policy::bind && !std::binary_search(online.begin(), online.end(), node))
+        throw std::invalid_argument ("NUMA node does not exist");
+    if (policy == numa_policy::first_touch || online.size() == 1)
+        return true;
+
+#if defined(__linux__) && defined(SYS_mbind)
+    const std::uintptr_t page = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+    const std::uintptr_t begin = (reinterpret_cast<std::uintptr_t>(p) + page - 1) / page * page;
+    const std::uintptr_t end = (reinterpret_cast<std::uintptr_t>(p) + bytes) / page * page;
+    if (begin >= end)
+        return true;
+
+    const int bits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(online.back() / bits + 1);
+    if (policy == numa_policy::bind) {
+        mask[node / bits] |= 1UL << (node % bits);
+    } else {
+        for (int i : online)
+            mask[i / bits] |= 1UL << (i % bits);
+    }
+    const int mode = policy == numa_policy::bind ? MPOL_BIND : MPOL_INTERLEAVE;
+    // maxnode counts bits, and the kernel reads one less than it is given
+    return syscall(SYS_mbind, begin, end - begin, mode, mask.data(),
+                   static_cast<unsigned long>(mask.size() * bits + 1), 0) == 0;
+#else
+    return true;
+#endif
+}
@@ -0,0 +1,75 @@
+// Memory bandwidth of a multithreaded kernel depending on where the pages of
+// its operand live. Build and run on a multi-socket Linux host:
+//
+//      g++ -std=c++20 -O2 -pthread numa_bench.cpp -o numa_bench && ./numa_bench [MiB]
+//
+// For each placement a matrix<double> of the given size (default 1024 MiB)
+// is allocated, then sum(m, per::row) streams over it a few times and the
+// best pass is reported. That reduction splits the rows with
+// parallel_row_grain, like the first-touch constructor, so with pinned
+// threads (the default on NUMA hosts) each chunk reads the pages it wrote.
+// "serial zero" is the plain constructor: one thread writes every page, so
+// all of them end up on one node. On a single-node host there is nothing to
+// compare and the benchmark exits right away.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <system_error>
+#include "matrix.hpp"
+#include "matrix_reduce.hpp"
+
+#define BENCH_PASSES    5
+#define BENCH_COLUMNS   1024
+
+template <typename Make>
+static void bench (const char* name, index_t nrows, Make make)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    matrix<double> m = make(nrows, BENCH_COLUMNS);
+    double init = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    const double bytes = sizeof(double) * double(nrows) * BENCH_COLUMNS;
+    double best = 0;
+    volatile double sink = 0;
+    for (int pass = 0; pass < BENCH_PASSES; ++pass) {
+        auto t = std::chrono::steady_clock::now();
+        sink = sink + sum(m, per::row)(1, 1);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+        best = std::max(best, bytes / secs / 1e9);
+    }
+    std::cout << name << "\tinit " << init << " s\trow sums " << best << " GB/s" << std::endl;
+}
+
+// a placement the kernel refuses is reported, and the others still run
+template <typename Make>
+static void try_bench (const char* name, index_t nrows, Make make)
+{
+    try {
+        bench(name, nrows, make);
+    } catch (const std::system_error& e) {
+        std::cout << name << "\t" << e.what() << std::endl;
+    }
+}
+
+int main (int argc, char* argv[])
+{
+    const int nnodes = numa_node_count();
+    if (nnodes < 2) {
+        std::cout << "numa_bench: single NUMA node, nothing to compare" << std::endl;
+        return 0;
+    }
+
+    const index_t mib = argc > 1 ? std::atoll(argv[1]) : 1024;
+    const index_t nrows = std::max(index_t {1}, (mib << 20) / index_t (sizeof(double) * BENCH_COLUMNS));
+    std::cout << "numa_bench: " << nnodes << " nodes, " << parallel_threads() << " threads"
+              << (parallel_pinning() ? " (pinned), " : ", ")
+              << nrows << " x " << BENCH_COLUMNS << " doubles" << std::endl;
+
+    bench("serial zero", nrows, [](index_t r, index_t c) {return matrix<double> {r, c};});
+    bench("first touch", nrows, [](index_t r, index_t c) {return matrix<double> {r, c, numa_policy::first_touch};});
+    try_bench("interleave", nrows, [](index_t r, index_t c) {return matrix<double> {r, c, numa_policy::interleave};});
+    const int node = numa_online_nodes().front();
+    try_bench("bind first node", nrows, [node](index_t r, index_t c) {return matrix<double> {r, c, numa_policy::bind, node};});
+    return 0;
+}
@@ -0,0 +1,177 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "numa.hpp"
+
+// Minimal fork/join helper shared by the multithreaded kernels.
+//
+// A range of n items is split into contiguous chunks of at least `grain`
+// items, at most one chunk per hardware thread. Chunk 0 runs on the calling
+// thread, unless pinning is on. Small ranges (n < 2 * grain) never leave the
+// calling thread.
+//
+// With pinning on (the default on NUMA hosts) every chunk of a split runs on
+// a fresh thread bound to a fixed CPU: chunk c of nchunks always lands on
+// parallel_chunk_cpu(c, nchunks). Two calls that split the same range the
+// same way, like the first-touch constructor of a matrix and a later
+// row-parallel kernel over it, thus run each chunk on the same CPU, and so
+// the same node as the pages that chunk wrote first.
+
+#define PARALLEL_MIN_GRAIN      (1 << 15)   // elements per thread worth a fork
+
+inline unsigned& parallel_thread_limit ()
+{
+    static unsigned limit = 0;      // 0: use all hardware threads
+    return limit;
+}
+
+// Caps the number of threads used by the kernels (0 restores the default).
+inline void set_parallel_threads (unsigned n)
+{
+    parallel_thread_limit() = n;
+}
+
+inline int parallel_threads ()
+{
+    unsigned n = parallel_thread_limit();
+    if (n == 0)
+        n = std::thread::hardware_concurrency();
+    return std::max(1, static_cast<int>(n));
+}
+
+enum class thread_pinning { numa_only, always, never };
+
+inline thread_pinning& parallel_pinning_mode ()
+{
+    static thread_pinning mode = thread_pinning::numa_only;
+    return mode;
+}
+
+// Whether chunk threads are pinned (thread_pinning::numa_only restores the
+// default: pin on hosts with more than one NUMA node).
+inline void set_parallel_pinning (thread_pinning mode)
+{
+    parallel_pinning_mode() = mode;
+}
+
+inline bool parallel_pinning ()
+{
+    const thread_pinning mode = parallel_pinning_mode();
+    return mode == thread_pinning::always || (mode == thread_pinning::numa_only && numa_node_count() > 1);
+}
+
+// CPUs the process may run on, in increasing order (empty when unknown)
+inline const std::vector<int>& parallel_cpus ()
+{
+    static const std::vector<int> cpus = [] {
+        std::vector<int> list;
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &set))
+                    list.push_back(cpu);
+            }
+        }
+#endif
+        return list;
+    }();
+    return cpus;
+}
+
+// CPU that chunk c out of nchunks is pinned to, or -1 when unknown. Chunks
+// are spread evenly over parallel_cpus(), in order.
+inline int parallel_chunk_cpu (int c, int nchunks)
+{
+    const std::vector<int>& cpus = parallel_cpus();
+    if (cpus.empty())
+        return -1;
+    return cpus[static_cast<std::size_t>(c) * cpus.size() / static_cast<std::size_t>(nchunks)];
+}
+
+// Binds the calling thread to the CPU of chunk c; false if that failed
+inline bool parallel_pin (int c, int nchunks)
+{
+#if defined(__linux__)
+    const int cpu = parallel_chunk_cpu(c, nchunks);
+    if (cpu < 0)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void) c;
+    (void) nchunks;
+    return false;
+#endif
+}
+
+// number of chunks parallel_for will use for n items
+inline int parallel_chunks (std::ptrdiff_t n, std::ptrdiff_t grain)
+{
+    grain = std::max(grain, std::ptrdiff_t {1});
+    return static_cast<int>(std::max(std::ptrdiff_t {1}, std::min<std::ptrdiff_t>(parallel_threads(), n / grain)));
+}
+
+// Grain for splitting the rows of a matrix with nclms columns. All
+// row-parallel kernels use it, so a row always lands in the same chunk --
+// the same split that matrix<T> uses to first-touch its storage.
+inline std::ptrdiff_t parallel_row_grain (std::ptrdiff_t nclms)
+{
+    return std::max(std::ptrdiff_t {1}, PARALLEL_MIN_GRAIN / std::max(nclms, std::ptrdiff_t {1}));
+}
+
+// [begin, end) of chunk c out of nchunks over n items
+inline void parallel_chunk_range (std::ptrdiff_t n, int nchunks, int c, std::ptrdiff_t& begin, std::ptrdiff_t& end)
+{
+    std::ptrdiff_t base = n / nchunks;
+    std::ptrdiff_t rem = n % nchunks;
+    begin = c * base + std::min<std::ptrdiff_t>(c, rem);
+    end = begin + base + (c < rem ? 1 : 0);
+}
+
+// Calls fn(chunk, begin, end) for every chunk of [0, n).
+template <typename F>
+void parallel_for (std::ptrdiff_t n, std::ptrdiff_t grain, F&& fn)
+{
+    const int nchunks = parallel_chunks(n, grain);
+    if (nchunks == 1) {
+        fn(0, 0, n);
+        return;
+    }
+
+    // pinned, chunk 0 gets its own thread too: the caller's CPU is arbitrary
+    const bool pin = parallel_pinning();
+    const int first = pin ? 0 : 1;
+    std::vector<std::thread> workers;
+    workers.reserve(nchunks - first);
+    for (int c = first; c < nchunks; ++c) {
+        std::ptrdiff_t begin, end;
+        parallel_chunk_range(n, nchunks, c, begin, end);
+        workers.emplace_back([&fn, c, begin, end, nchunks, pin] {
+            if (pin)
+                parallel_pin(c, nchunks);
+            fn(c, begin, end);
+        });
+    }
+    if (pin) {
+        for (auto& w : workers)
+            w.join();
+        return;
+    }
+
+    std::ptrdiff_t begin, end;
+    parallel_chunk_range(n, nchunks, 0, begin, end);
+    fn(0, begin, end);
+
+    for (auto& w : workers)
+        w.join();
+}
@@ -0,0 +1,965 @@
+#pragma once
+#include <algorithm>
+#include <concepts>
+#include <stdexcept>
+#include "matrix.hpp"
+
+// Structured square matrices: only the elements implied by the structure are
+// stored, everything else is an implicit zero (or, for symmetric, a mirror).
+//
+// Indexing is 1-based like matrix<T>. The const operator() returns any element
+// by value; the non-const operator() returns a reference to a stored element
+// and throws if (row, clm) is an implicit zero.
+//
+// Every type provides
+//      rows(), columns(), to_dense(), transpose(), operator ==,
+//      +, +=, -, -= and * against the same type,
+//      add_to(matrix<T>&, alpha) -- dense += alpha * structured, stored elements only,
+// and the free operators below make them usable against matrix<T>.
+
+enum class uplo { upper, lower };
+
+template <typename S>
+concept structured = requires (const S& s, matrix<typename S::value_type>& m) {
+    { s.to_dense() } -> std::same_as<matrix<typename S::value_type>>;
+    s.add_to(m, typename S::value_type {1});
+};
+
+// y[0..n) += alpha * x[0..n)
+template <typename T>
+static inline void row_axpy (T* y, const T* x, T alpha, index_t n)
+{
+    for (index_t j = 0; j < n; ++j)
+        y[j] += alpha * x[j];
+}
+
+static inline void check_structured_index (index_t row, index_t clm, index_t n)
+{
+    if (row < 1 || row > n || clm < 1 || clm > n)
+        throw std::length_error ("Invalid index");
+}
+
+static inline void check_structured_dim (index_t n)
+{
+    if (n < 0)
+        throw std::invalid_argument ("dimension must be non-negative value");
+}
+
+template <typename T>
+static void check_square (const matrix<T>& a)
+{
+    if (a.rows() != a.columns())
+        throw std::invalid_argument ("matrix must be square");
+}
+
+
+/*
+ * symmetric_matrix: lower triangle packed row by row, n(n+1)/2 elements.
+ * (row, clm) and (clm, row) refer to the same stored element.
+ */
+template <typename T>
+requires std::integral<T> || std::floating_point<T>
+class symmetric_matrix {
+    private:
+        index_t n;
+        Vector<T> elems;
+
+        // 0-based offset of (row, clm) with row >= clm
+        static index_t packed (index_t row, index_t clm) {return row * (row + 1) / 2 + clm;};
+
+    public:
+        using value_type = T;
+
+        symmetric_matrix (index_t n = 10);
+        // takes the lower triangle of a, the upper triangle is ignored
+        explicit symmetric_matrix (const matrix<T>& a);
+
+        index_t rows() const {return n;};
+        index_t columns() const {return n;};
+
+        T& operator () (index_t row, index_t clm);
+        const T& operator () (index_t row, index_t clm) const;
+
+        matrix<T> to_dense () const;
+        symmetric_matrix<T> transpose () const {return *this;};
+        void add_to (matrix<T>& a, T alpha = 1) const;
+
+        symmetric_matrix<T> operator +(symmetric_matrix<T> a) const {a += *this; return a;};
+        symmetric_matrix<T>& operator +=(const symmetric_matrix<T>& a);
+        symmetric_matrix<T> operator -(const symmetric_matrix<T>& a) const {auto mr = *this; mr -= a; return mr;};
+        symmetric_matrix<T>& operator -=(const symmetric_matrix<T>& a);
+
+        bool operator ==(const symmetric_matrix<T>& a) const;
+
+        // A * B for dense B, visiting every stored element once
+        matrix<T> operator *(const matrix<T>& b) const;
+        matrix<T> operator *(const symmetric_matrix<T>& b) const {return *this * b.to_dense();};
+        template <typename U>
+        friend matrix<U> operator *(const matrix<U>& a, const symmetric_matrix<U>& s);
+};
+
+template <typename T>
+symmetric_matrix<T>::symmetric_matrix (index_t n) : n(n)
+{
+    check_structured_dim(n);
+    elems.resize_exact(checked_size<T>(n, n + 1) / 2);
+}
+
+template <typename T>
+symmetric_matrix<T>::symmetric_matrix (const matrix<T>& a) : symmetric_matrix(a.rows())
+{
+    check_square(a);
+    for (index_t i = 0; i < n; ++i)
+        std::copy(a.data() + i * a.stride(), a.data() + i * a.stride() + i + 1, elems.data() + packed(i, 0));
+}
+
+template <typename T>
+T& symmetric_matrix<T>::operator () (index_t row, index_t clm)
+{
+    check_structured_index(row, clm, n);
+    return row >= clm ? elems[packed(row-1, clm-1)] : elems[packed(clm-1, row-1)];
+}
+
+template <typename T>
+const T& symmetric_matrix<T>::operator () (index_t row, index_t clm) const
+{
+    check_structured_index(row, clm, n);
+    return row >= clm ? elems[packed(row-1, clm-1)] : elems[packed(clm-1, row-1)];
+}
+
+template <typename T>
+matrix<T> symmetric_matrix<T>::to_dense () const
+{
+    matrix<T> mr {n, n};
+    add_to(mr, 1);
+    return mr;
+}
+
+template <typename T>
+void symmetric_matrix<T>::add_to (matrix<T>& a, T alpha) const
+{
+    if (a.rows() != n || a.columns() != n)
+        throw std::invalid_argument ("number of rows and/or columns are not the same");
+
+    T* pa = a.data();
+    const index_t ld = a.stride();
+    const T* p = elems.data();
+    for (index_t i = 0; i < n; ++i) {
+        for (index_t j = 0; j < i; ++j) {
+            pa[i * ld + j] += alpha * p[packed(i, j)];
+            pa[j * ld + i] += alpha * p[packed(i, j)];
+        }
+        pa[i * ld + i] += alpha * p[packed(i, i)];
+    }
+}
+
+template <typename T>
+symmetric_matrix<T>& symmetric_matrix<T>::operator +=(const symmetric_matrix<T>& a)
+{
+    if (n != a.n)
+        throw std::invalid_argument ("number of rows and/or columns are not the same");
+
+    row_axpy(elems.data(), a.elems.data(), T {1}, elems.size());
+    return *this;
+}
+
+template <typename T>
+symmetric_matrix<T>& symmetric_matrix<T>::operator -=(const symmetric_matrix<T>& a)
+{
+    if (n != a.n)
+        throw std::invalid_argument ("number of rows and/or columns are not the same");
+
+    row_axpy(elems.data(), a.elems.data(), T(-1), elems.size());
+    return *this;
+}
+
+template <typename T>
+bool symmetric_matrix<T>::operator ==(const symmetric_matrix<T>& a) const
+{
+    return n == a.n && std::equal(elems.begin(), elems.end(), a.elems.begin());
+}
+
+template <typename T>
+matrix<T> symmetric_matrix<T>::operator *(const matrix<T>& b) const
+{
+    if (n != b.rows())
+        throw std::invalid_argument ("number of rows/columns mismatch");
+
+    const index_t m = b.columns();
+    matrix<T> mr {n, m};
+    const T* p = elems.data();
+    const T* pb = b.data();
+    const index_t ldb = b.stride();
+    T* pr = mr.data();
+
+    // each off-diagonal s(i, k) contributes to both rows i and k of the result
+    for (index_t i = 0; i < n; ++i) {
+        for (index_t k = 0; k < i; ++k) {
+            T s = p[packed(i, k)];
+            row_axpy(pr + i * m, pb + k * ldb, s, m);
+            row_axpy(pr + k * m, pb + i * ldb, s, m);
+        }
+        row_axpy(pr + i * m, pb + i * ldb, p[packed(i, i)], m);
+    }
+    return mr;
+}
+
+template <typename T>
+matrix<T> operator *(const matrix<T>& a, const symmetric_matrix<T>& s)
+{
+    const index_t n = s.n;
+    if (a.columns() != n)
+        throw std::invalid_argument ("number of rows/columns mismatch");
+
+    const index_t m = a.rows();
+    matrix<T> mr {m, n};
+    const T* p = s.elems.data();
+
+    // row r of the result is (row r of a) * s
+    for (index_t r = 0; r < m; ++r) {
+        const T* pa = a.data() + r * a.stride();
+        T* pr = mr.data() + r * n;
+        for (index_t k = 0; k < n; ++k) {
+            // row k of the packed lower triangle holds s(k, 0..k)
+            const T* sk = p + symmetric_matrix<T>::packed(k, 0);
+            row_axpy(pr, sk, pa[k], k);
+            T acc = 0;
+            for (index_t j = 0; j < k; ++j)
+                acc += pa[j] * sk[j];
+            pr[k] += acc + pa[k] * sk[k];
+        }
+    }
+    return mr;
+}
+
+
+/*
+ * triangular_matrix: upper (clm >= row) or lower (clm <= row) triangle,
+ * packed row by row, n(n+1)/2 elements.
+ */
+template <typename T, uplo UL>
+requires std::integral<T> || std::floating_point<T>
+class triangular_matrix {
+    private:
+        index_t n;
+        Vector<T> elems;
+
+        // 0-based offset of the first stored element of row i
+        index_t row_offset (index_t i) const
+        {
+            return UL == uplo::lower ? i * (i + 1) / 2 : i * n - i * (i - 1) / 2;
+        };
+        // 0-based [first, last) columns stored in row i
+        index_t first_clm (index_t i) const {return UL == uplo::lower ? 0 : i;};
+        index_t last_clm (index_t i) const {return UL == uplo::lower ? i + 1 : n;};
+        bool stored (index_t row, index_t clm) const {return UL == uplo::lower ? clm <= row : clm >= row;};
+
+    public:
+        using value_type = T;
+        static constexpr uplo shape = UL;
+
+        triangular_matrix (index_t n = 10);
+        // takes the matching triangle of a, the other one is ignored
+        explicit triangular_matrix (const matrix<T>& a);
+
+        index_t rows() const {return n;};
+        index_t columns() const {return n;};
+
+        T& operator () (index_t row, index_t clm);
+        T operator () (index_t row, index_t clm) const;
+
+        matrix<T> to_dense () const;
+        triangular_matrix<T, UL == uplo::upper ? uplo::lower : uplo::upper> transpose () const;
+        void add_to (matrix<T>& a, T alpha = 1) const;
+
+        triangular_matrix<T, UL> operator +(triangular_matrix<T, UL> a) const {a += *this; return a;};
+        triangular_matrix<T, UL>& operator +=(const triangular_matrix<T, UL>& a);
+        triangular_matrix<T, UL> operator -(const triangular_matrix<T, UL>& a) const {auto mr = *this; mr -= a; return mr;};
+        triangular_matrix<T, UL>& operator -=(const triangular_matrix<T, UL>& a);
+
+        bool operator ==(const triangular_matrix<T, UL>& a) const;
+
+        matrix<T> operator *(const matrix<T>& b) const;
+        // the product of two triangles of the same shape keeps that shape
+        triangular_matrix<T, UL> operator *(const triangular_matrix<T, UL>& b) const;
+        template <typename U, uplo V>
+        friend matrix<U> operator *(const matrix<U>& a, const triangular_matrix<U, V>& t);
+
+        template <typename U, uplo V>
+        requires std::integral<U> || std::floating_point<U>
+        friend class triangular_matrix;
+};
+
+template <typename T>
+using upper_triangular = triangular_matrix<T, uplo::upper>;
+template <typename T>
+using lower_triangular = triangular_matrix<T, uplo::lower>;
+
+template <typename T, uplo UL>
+triangular_matrix<T, UL>::triangular_matrix (index_t n) : n(n)
+{
+    check_structured_dim(n);
+    elems.resize_exact(checked_size<T>(n, n + 1) / 2);
+}
+
+template <typename T, uplo UL>
+triangular_matrix<T, UL>::triangular_matrix (const matrix<T>& a) : triangular_matrix(a.rows())
+{
+    check_square(a);
+    for (index_t i = 0; i < n; ++i)
+        std::copy(a.data() + i * a.stride() + first_clm(i), a.data() + i * a.stride() + last_clm(i),
+                  elems.data() + row_offset(i));
+}
+
+template <typename T, uplo UL>
+T& triangular_matrix<T, UL>::operator () (index_t row, index_t clm)
+{
+    check_structured_index(row, clm, n);
+    if (!stored(row, clm))
+        throw std::invalid_argument ("element is outside the stored triangle");
+    return elems[row_offset(row-1) + (clm-1) - first_clm(row-1)];
+}
+
+template <typename T, uplo UL>
+T triangular_matrix<T, UL>::operator () (index_t row, index_t clm) const
+{
+    check_structured_index(row, clm, n);
+    if (!stored(row, clm))
+        return T {};
+    return elems[row_offset(row-1) + (clm-1) - first_clm(row-1)];
+}
+
+template <typename T, uplo UL>
+matrix<T> triangular_matrix<T, UL>::to_dense () const
+{
+    matrix<T> mr {n, n};
+    add_to(mr, 1);
+    return mr;
+}
+
+template <typename T, uplo UL>
+triangular_matrix<T, UL == uplo::upper ? uplo::lower : uplo::upper> triangular_matrix<T, UL>::transpose () const
+{
+    triangular_matrix<T, UL == uplo::upper ? uplo::lower : uplo::upper> mt {n};
+    const T* p = elems.data();
+    for (index_t i = 0; i < n; ++i) {
+        for (index_t j = first_clm(i); j < last_clm(i); ++j)
+            mt.elems[mt.row_offset(j) + i - mt.first_clm(j)] = p[row_offset(i) + j - first_clm(i)];
+    }
+    return mt;
+}
+
+template <typename T, uplo UL>
+void triangular_matrix<T, UL>::add_to (matrix<T>& a, T alpha) const
+{
+    if (a.rows() != n || a.columns() != n)
+        throw std::invalid_argument ("number of rows and/or columns are not the same");
+
+    for (index_t i = 0; i < n; ++i)
+        row_axpy(a.data() + i * a.stride() + first_clm(i), elems.data() + row_offset(i), alpha,
+                 last_clm(i) - first_clm(i));
+}
+
+template <typename T, uplo UL>
+triangular_matrix<T, UL>& triangular_matrix<T, UL>::operator +=(const triangular_matrix<T, UL>& a)
+{
+    if (n != a.n)
+        throw std::invalid_argument ("number of rows and/or columns are not the same");
+
+    row_axpy(elems.data(), a.elems.data(), T {1}, elems.size());
+    return *this;
+}
+
+template <typename T, uplo UL>
+triangular_matrix<T, UL>& triangular_matrix<T, UL>::operator -=(const triangular_matrix<T, UL>& a)
+{
+    if (n != a.n)
+        throw std::invalid_argument ("number of rows and/or columns are not the same");
+
+    row_axpy(elems.data(), a.elems.data(), T(-1), elems.size());
+    return *this;
+}
+
+template <typename T, uplo UL>
+bool triangular_matrix<T, UL>::operator ==(const triangular_matrix<T, UL>& a) const
+{
+    return n == a.n && std::equal(elems.begin(), elems.end(), a.elems.begin());
+}
+
+template <typename T, uplo UL>
+matrix<T> triangular_matrix<T, UL>::operator *(const matrix<T>& b) const
+{
+    if (n != b.rows())
+        throw std::invalid_argument ("number of rows/columns mismatch");
+
+    const index_t m = b.columns();
+    matrix<T> mr {n, m};
+    const T* p = elems.data();
+
+    // only the stored part of row i contributes to row i of the result
+    for (index_t i = 0; i < n; ++i) {
+        const T* ti = p + row_offset(i) - first_clm(i);
+        for (index_t k = first_clm(i); k < last_clm(i); ++k)
+            row_axpy(mr.data() + i * m, b.data() + k * b.stride(), ti[k], m);
+    }
+    return mr;
+}
+
+template <typename T, uplo UL>
+triangular_matrix<T, UL> triangular_matrix<T, UL>::operator *(const triangular_matrix<T, UL>& b) const
+{
+    if (n != b.n)
+        throw std::invalid_argument ("number of rows/columns mismatch");
+
+    triangular_matrix<T, UL> mr {n};
+    const T* p = elems.data();
+    const T* pb = b.elems.data();
+
+    // (row i) += a(i, k) * (row k of b); both rows live inside the same triangle
+    for (index_t i = 0; i < n; ++i) {
+        T* ri = mr.elems.data() + mr.row_offset(i) - first_clm(i);
+        const T* ai = p + row_offset(i) - first_clm(i);
+        for (index_t k = first_clm(i); k < last_clm(i); ++k) {
+            index_t lo = std::max(first_clm(i), b.first_clm(k));
+            index_t hi = std::min(last_clm(i), b.last_clm(k));
+            const T* bk = pb + b.row_offset(k) - b.first_clm(k);
+            row_axpy(ri + lo, bk + lo, ai[k], hi - lo);
+        }
+    }
+    return mr;
+}
+
+template <typename T, uplo UL>
+matrix<T> operator *(const matrix<T>& a, const triangular_matrix<T, UL>& t)
+{
+    const index_t n = t.n;
+    if (a.columns() != n)
+        throw std::invalid_argument ("number of rows/columns mismatch");
+
+    const index_t m = a.rows();
+    matrix<T> mr {m, n};
+    const T* p = t.elems.data();
+
+    for (index_t r = 0; r < m; ++r) {
+        const T* pa = a.data() + r * a.stride();
+        T* pr = mr.data() + r * n;
+        for (index_t k = 0; k < n; ++k)
+            row_axpy(pr + t.first_clm(k), p + t.row_offset(k), pa[k], t.last_clm(k) - t.first_clm(k));
+    }
+    return mr;
+}
+
+
+/*
+ * diagonal_matrix: only the n diagonal elements are stored.
+ */
+template <typename T>
+requires std::integral<T> || std::floating_point<T>
+class diagonal_matrix {
+    private:
+        index_t n;
+        Vector<T> elems;
+
+    public:
+        using value_type = T;
+
+        diagonal_matrix (index_t n = 10);
+        // takes the diagonal of a, everything else is ignored
+        explicit diagonal_matrix (const matrix<T>& a);
+
+        index_t rows() const {return n;};
+        index_t columns() const {return n;};
+
+        T& operator () (index_t row, index_t clm);
+        T operator () (index_t row, index_t clm) const;
+
+        matrix<T> to_dense () const;
+        diagonal_matrix<T> transpose () const {return *this;};
+        void add_to (matrix<T>& a, T alpha = 1) const;
+
+        diagonal_matrix<T> operator +(diagonal_matrix<T> a) const {a += *this; return a;};
+        diagonal_matrix<T>& operator +=(const diagonal_matrix<T>& a);
+        diagonal_matrix<T> operator -(const diagonal_matrix<T>& a) const {auto mr = *this; mr -= a; return mr;};
+        diagonal_matrix<T>& operator -=(const diagonal_matrix<T>& a);
+
+        bool operator ==(const diagonal_matrix<T>& a) const;
+
+        // scales the rows of b
+        matrix<T> operator *(const matrix<T>& b) const;
+        diagonal_matrix<T> operator *(const diagonal_matrix<T>& b) const;
+        // scales the columns of a
+        template <typename U>
+        friend matrix<U> operator *(const matrix<U>& a, const diagonal_matrix<U>& d);
+};
+
+template <typename T>
+diagonal_matrix<T>::diagonal_matrix (index_t n) : n(n)
+{
+    check_structured_dim(n);
+    elems.resize_exact(n);
+}
+
+template <typename T>
+diagonal_matrix<T>::diagonal_matrix (const matrix<T>& a) : diagonal_matrix(a.rows())
+{
+    check_square(a);
+    for (index_t i = 0; i < n; ++i)
+        elems[i] = a.data()[i * a.stride() + i];
+}
+
+template <typename T>
+T& diagonal_matrix<T>::operator () (index_t row, index_t clm)
+{
+    check_structured_index(row, clm, n);
+    if (row != clm)
+        throw std::invalid_argument ("element is outside the stored diagonal");
+    return elems[row-1];
+}
+
+template <typename T>
+T diagonal_matrix<T>::operator () (index_t row, index_t clm) const
+{
+    check_structured_index(row, clm, n);
+    return row == clm ? elems[row-1] : T {};
+}
+
+template <typename T>
+matrix<T> diagonal_matrix<T>::to_dense () const
+{
+    matrix<T> mr {n, n};
+    add_to(mr, 1);
+    return mr;
+}
+
+template <typename T>
+void diagonal_matrix<T>::add_to (matrix<T>& a, T alpha) const
+{
+    if (a.rows() != n || a.columns() != n)
+        throw std::invalid_argument ("number of rows and/or columns are not the same");
+
+    T* pa = a.data();
+    const index_t ld = a.stride();
+    for (index_t i = 0; i < n; ++i)
+        pa[i * ld + i] += alpha * elems[i];
+}
+
+template <typename T>
+diagonal_matrix<T>& diagonal_matrix<T>::operator +=(const diagonal_matrix<T>& a)
+{
+    if (n != a.n)
+        throw std::invalid_argument ("number of rows and/or columns are not the same");
+
+    row_axpy(elems.data(), a.elems.data(), T {1}, n);
+    return *this;
+}
+
+template <typename T>
+diagonal_matrix<T>& diagonal_matrix<T>::operator -=(const diagonal_matrix<T>& a)
+{
+    if (n != a.n)
+        throw std::invalid_argument ("number of rows and/or columns are not the same");
+
+    row_axpy(elems.data(), a.elems.data(), T(-1), n);
+    return *this;
+}
+
+template <typename T>
+bool diagonal_matrix<T>::operator ==(const diagonal_matrix<T>& a) const
+{
+    return n == a.n && std::equal(elems.begin(), elems.end(), a.elems.begin());
+}
+
+template <typename T>
+matrix<T> diagonal_matrix<T>::operator *(const matrix<T>& b) const
+{
+    if (n != b.rows())
+        throw std::invalid_argument ("number of rows/columns mismatch");
+
+    const index_t m = b.columns();
+    matrix<T> mr {n, m};
+    for (index_t i = 0; i < n; ++i) {
+        const T d = elems[i];
+        const T* pb = b.data() + i * b.stride();
+        T* pr = mr.data() + i * m;
+        for (index_t j = 0; j < m; ++j)
+            pr[j] = d * pb[j];
+    }
+    return mr;
+}
+
+template <typename T>
+diagonal_matrix<T> diagonal_matrix<T>::operator *(const diagonal_matrix<T>& b) const
+{
+    if (n != b.n)
+        throw std::invalid_argument ("number of rows/columns mismatch");
+
+    diagonal_matrix<T> mr {n};
+    for (index_t i = 0; i < n; ++i)
+        mr.elems[i] = elems[i] * b.elems[i];
+    return mr;
+}
+
+template <typename T>
+matrix<T> operator *(const matrix<T>& a, const diagonal_matrix<T>& d)
+{
+    const index_t n = d.n;
+    if (a.columns() != n)
+        throw std::invalid_argument ("number of rows/columns mismatch");
+
+    const index_t m = a.rows();
+    matrix<T> mr {m, n};
+    const T* pd = d.elems.data();
+    for (index_t r = 0; r < m; ++r) {
+        const T* pa = a.data() + r * a.stride();
+        T* pr = mr.data() + r * n;
+        for (index_t j = 0; j < n; ++j)
+            pr[j] = pa[j] * pd[j];
+    }
+    return mr;
+}
+
+
+/*
+ * banded_matrix: kl sub-diagonals and ku super-diagonals. Row i keeps
+ * kl + ku + 1 slots for columns i-kl .. i+ku; slots that fall outside the
+ * matrix (in the first and last rows) are padding and stay zero.
+ */
+template <typename T>
+requires std::integral<T> || std::floating_point<T>
+class banded_matrix {
+    private:
+        index_t n;
+        index_t kl;
+        index_t ku;
+        Vector<T> elems;
+
+        index_t width () const {return kl + ku + 1;};
+        // 0-based [first, last) columns stored in row i
+        index_t first_clm (index_t i) const {return std::max(index_t {0}, i - kl);};
+        index_t last_clm (index_t i) const {return std::min(n, i + ku + 1);};
+        // pointer p such that p[j] is element (i, j), valid for first_clm(i) <= j < last_clm(i)
+        T* row_base (index_t i) {return elems.data() + i * width() + kl - i;};
+        const T* row_base (index_t i) const {return elems.data() + i * width() + kl - i;};
+        bool stored (index_t row, index_t clm) const {return clm - row <= ku && row - clm <= kl;};
+
+    public:
+        using value_type = T;
+
+        banded_matrix (index_t n = 10, index_t kl = 0, index_t ku = 0);
+        // takes the band of a, everything else is ignored
+        banded_matrix (const matrix<T>& a, index_t kl, index_t ku);
+
+        index_t rows() const {return n;};
+        index_t columns() const {return n;};
+        index_t lower_bandwidth() const {return kl;};
+        index_t upper_bandwidth() const {return ku;};
+
+        T& operator () (index_t row, index_t clm);
+        T operator () (index_t row, index_t clm) const;
+
+        matrix<T> to_dense () const;
+        banded_matrix<T> transpose () const;
+        void add_to (matrix<T>& a, T alpha = 1) const;
+
+        // the result has the wider of the two bandwidths on each side
+        banded_matrix<T> operator +(const banded_matrix<T>& a) const;
+        banded_matrix<T>& operator +=(const banded_matrix<T>& a);
+        banded_matrix<T> operator -(const banded_matrix<T>& a) const;
+        banded_matrix<T>& operator -=(const banded_matrix<T>& a);
+
+        // bandwidths may differ; elements outside a narrower band compare as zero
+        bool operator ==(const banded_matrix<T>& a) const;
+
+        matrix<T> operator *(const matrix<T>& b) const;
+        // the product has bandwidths (kl + b.kl, ku + b.ku)
+        banded_matrix<T> operator *(const banded_matrix<T>& b) const;
+        template <typename U>
+        friend matrix<U> operator *(const matrix<U>& a, const banded_matrix<U>& b);
+
+    private:
+        banded_matrix<T> widened (index_t nkl, index_t nku) const;
+        void accumulate (const banded_matrix<T>& a, T alpha);
+};
+
+template <typename T>
+banded_matrix<T>::banded_matrix (index_t n, index_t kl, index_t ku) : n(n), kl(kl), ku(ku)
+{
+    check_structured_dim(n);
+    if (kl < 0 || ku < 0)
+        throw std::invalid_argument ("bandwidths must be non-negative value");
+    // bandwidths beyond n - 1 only add padding
+    this->kl = std::min(kl, std::max(n - 1, index_t {0}));
+    this->ku = std::min(ku, std::max(n - 1, index_t {0}));
+    elems.resize_exact(checked_size<T>(n, width()));
+}
+
+template <typename T>
+banded_matrix<T>::banded_matrix (const matrix<T>& a, index_t kl, index_t ku) : banded_matrix(a.rows(), kl, ku)
+{
+    check_square(a);
+    for (index_t i = 0; i < n; ++i)
+        std::copy(a.data() + i * a.stride() + first_clm(i), a.data() + i * a.stride() + last_clm(i),
+                  row_base(i) + first_clm(i));
+}
+
+template <typename T>
+T& banded_matrix<T>::operator () (index_t row, index_t clm)
+{
+    check_structured_index(row, clm, n);
+    if (!stored(row, clm))
+        throw std::invalid_argument ("element is outside the stored band");
+    return row_base(row-1)[clm-1];
+}
+
+template <typename T>
+T banded_matrix<T>::operator () (index_t row, index_t clm) const
+{
+    check_structured_index(row, clm, n);
+    if (!stored(row, clm))
+        return T {};
+    return row_base(row-1)[clm-1];
+}
+
+template <typename T>
+matrix<T> banded_matrix<T>::to_dense () const
+{
+    matrix<T> mr {n, n};
+    add_to(mr, 1);
+    return mr;
+}
+
+template <typename T>
+banded_matrix<T> banded_matrix<T>::transpose () const
+{
+    banded_matrix<T> mt {n, ku, kl};
+    for (index_t i = 0; i < n; ++i) {
+        for (index_t j = first_clm(i); j < last_clm(i); ++j)
+            mt.row_base(j)[i] = row_base(i)[j];
+    }
+    return mt;
+}
+
+template <typename T>
+void banded_matrix<T>::add_to (matrix<T>& a, T alpha) const
+{
+    if (a.rows() != n || a.columns() != n)
+        throw std::invalid_argument ("number of rows and/or columns are not the same");
+
+    for (index_t i = 0; i < n; ++i)
+        row_axpy(a.data() + i * a.stride() + first_clm(i), row_base(i) + first_clm(i), alpha,
+                 last_clm(i) - first_clm(i));
+}
+
+template <typename T>
+banded_matrix<T> banded_matrix<T>::widened (index_t nkl, index_t nku) const
+{
+    banded_matrix<T> mr {n, nkl, nku};
+    for (index_t i = 0; i < n; ++i)
+        std::copy(row_base(i) + first_clm(i), row_base(i) + last_clm(i), mr.row_base(i) + first_clm(i));
+    return mr;
+}
+
+template <typename T>
+void banded_matrix<T>::accumulate (const banded_matrix<T>& a, T alpha)
+{
+    if (n != a.n)
+        throw std::invalid_argument ("number of rows and/or columns are not the same");
+
+    if (a.kl > kl || a.ku > ku)
+        *this = widened(std::max(kl, a.kl), std::max(ku, a.ku));
+
+    if (a.kl == kl && a.ku == ku) {
+        row_axpy(elems.data(), a.elems.data(), alpha, elems.size());
+        return;
+    }
+    for (index_t i = 0; i < n; ++i)
+        row_axpy(row_base(i) + a.first_clm(i), a.row_base(i) + a.first_clm(i), alpha,
+                 a.last_clm(i) - a.first_clm(i));
+}
+
+template <typename T>
+banded_matrix<T> banded_matrix<T>::operator +(const banded_matrix<T>& a) const
+{
+    auto mr = *this;
+    mr += a;
+    return mr;
+}
+
+template <typename T>
+banded_matrix<T>& banded_matrix<T>::operator +=(const banded_matrix<T>& a)
+{
+    accumulate(a, 1);
+    return *this;
+}
+
+template <typename T>
+banded_matrix<T> banded_matrix<T>::operator -(const banded_matrix<T>& a) const
+{
+    auto mr = *this;
+    mr -= a;
+    return mr;
+}
+
+template <typename T>
+banded_matrix<T>& banded_matrix<T>::operator -=(const banded_matrix<T>& a)
+{
+    accumulate(a, -1);
+    return *this;
+}
+
+template <typename T>
+bool banded_matrix<T>::operator ==(const banded_matrix<T>& a) const
+{
+    if (n != a.n)
+        return false;
+    if (kl == a.kl && ku == a.ku)
+        return std::equal(elems.begin(), elems.end(), a.elems.begin());
+
+    const index_t wkl = std::max(kl, a.kl);
+    const index_t wku = std::max(ku, a.ku);
+    for (index_t i = 1; i <= n; ++i) {
+        for (index_t j = std::max(index_t {1}, i - wkl); j <= std::min(n, i + wku); ++j) {
+            if ((*this)(i, j) != a(i, j))
+                return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+matrix<T> banded_matrix<T>::operator *(const matrix<T>& b) const
+{
+    if (n != b.rows())
+        throw std::invalid_argument ("number of rows/columns mismatch");
+
+    const index_t m = b.columns();
+    matrix<T> mr {n, m};
+    for (index_t i = 0; i < n; ++i) {
+        const T* ai = row_base(i);
+        for (index_t k = first_clm(i); k < last_clm(i); ++k)
+            row_axpy(mr.data() + i * m, b.data() + k * b.stride(), ai[k], m);
+    }
+    return mr;
+}
+
+template <typename T>
+banded_matrix<T> banded_matrix<T>::operator *(const banded_matrix<T>& b) const
+{
+    if (n != b.n)
+        throw std::invalid_argument ("number of rows/columns mismatch");
+
+    banded_matrix<T> mr {n, kl + b.kl, ku + b.ku};
+    for (index_t i = 0; i < n; ++i) {
+        const T* ai = row_base(i);
+        T* ri = mr.row_base(i);
+        for (index_t k = first_clm(i); k < last_clm(i); ++k)
+            row_axpy(ri + b.first_clm(k), b.row_base(k) + b.first_clm(k), ai[k], b.last_clm(k) - b.first_clm(k));
+    }
+    return mr;
+}
+
+template <typename T>
+matrix<T> operator *(const matrix<T>& a, const banded_matrix<T>& b)
+{
+    const index_t n = b.n;
+    if (a.columns() != n)
+        throw std::invalid_argument ("number of rows/columns mismatch");
+
+    const index_t m = a.rows();
+    matrix<T> mr {m, n};
+    for (index_t r = 0; r < m; ++r) {
+        const T* pa = a.data() + r * a.stride();
+        T* pr = mr.data() + r * n;
+        for (index_t k = 0; k < n; ++k)
+            row_axpy(pr + b.first_clm(k), b.row_base(k) + b.first_clm(k), pa[k], b.last_clm(k) - b.first_clm(k));
+    }
+    return mr;
+}
+
+
+// Mixing structured and dense operands through the usual operators.
+
+template <structured S>
+matrix<typename S::value_type> operator +(const S& s, matrix<typename S::value_type> a)
+{
+    s.add_to(a, 1);
+    return a;
+}
+
+template <structured S>
+matrix<typename S::value_type> operator +(matrix<typename S::value_type> a, const S& s)
+{
+    s.add_to(a, 1);
+    return a;
+}
+
+template <structured S>
+matrix<typename S::value_type> operator -(matrix<typename S::value_type> a, const S& s)
+{
+    s.add_to(a, -1);
+    return a;
+}
+
+template <structured S>
+matrix<typename S::value_type> operator -(const S& s, const matrix<typename S::value_type>& a)
+{
+    auto mr = s.to_dense();
+    mr -= a;
+    return mr;
+}
+
+template <structured S>
+matrix<typename S::value_type>& operator +=(matrix<typename S::value_type>& a, const S& s)
+{
+    s.add_to(a, 1);
+    return a;
+}
+
+template <structured S>
+matrix<typename S::value_type>& operator -=(matrix<typename S::value_type>& a, const S& s)
+{
+    s.add_to(a, -1);
+    return a;
+}
+
+// sums of two different structures are dense
+template <structured S1, structured S2>
+requires (!std::same_as<S1, S2>) && std::same_as<typename S1::value_type, typename S2::value_type>
+matrix<typename S1::value_type> operator +(const S1& a, const S2& b)
+{
+    auto mr = a.to_dense();
+    b.add_to(mr, 1);
+    return mr;
+}
+
+template <structured S1, structured S2>
+requires (!std::same_as<S1, S2>) && std::same_as<typename S1::value_type, typename S2::value_type>
+matrix<typename S1::value_type> operator -(const S1& a, const S2& b)
+{
+    auto mr = a.to_dense();
+    b.add_to(mr, -1);
+    return mr;
+}
+
+// products of two different structures fall back to structured * dense
+template <structured S1, structured S2>
+requires (!std::same_as<S1, S2>) && std::same_as<typename S1::value_type, typename S2::value_type>
+matrix<typename S1::value_type> operator *(const S1& a, const S2& b)
+{
+    return a * b.to_dense();
+}
+
+template <structured S>
+bool operator ==(const S& s, const matrix<typename S::value_type>& a)
+{
+    if (s.rows() != a.rows() || s.columns() != a.columns())
+        return false;
+
+    for (index_t i = 1; i <= a.rows(); ++i) {
+        for (index_t j = 1; j <= a.columns(); ++j) {
+            if (s(i, j) != a(i, j))
+                return false;
+        }
+    }
+    return true;
+}